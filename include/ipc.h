@@ -37,6 +37,68 @@
 #define IPC_ANY    0
 
 
+/**
+
+    Constant: IPC_NOTIFICATION
+    --------------------------
+
+    Source of a notification message.
+    Message data holds the pending notifications bitmap (64 bits, 
+    bit `pid` is set when process `pid` has notified, see IPC_SET_PIDS)
+
+**/
+
+#define IPC_NOTIFICATION    0xFFFFFFFF
+
+
+/**
+
+    Constant: IPC_SET_WORDS
+    -----------------------
+
+    Size (in 32 bits words) of sources sets, used by `ipc_receive_set` 
+    and notifications bitmaps. Bit `pid` stands for process `pid`.
+
+**/
+
+#define IPC_SET_WORDS    2
+
+
+/**
+
+    Constant: IPC_SET_PIDS
+    ----------------------
+
+    Number of process ids a sources set holds. Kernel only gives
+    out pids below it, so sets and notifications bitmaps are exact.
+
+**/
+
+#define IPC_SET_PIDS    (IPC_SET_WORDS*32)
+
+
+/**
+
+    Macros: IPC_SET_ADD, IPC_SET_ISIN
+    ---------------------------------
+
+    Add process `__pid` to sources set `__set`, check its membership.
+    A pid out of set range is never added nor member.
+
+**/
+
+#define IPC_SET_ADD(__set,__pid)			\
+  {							\
+    if ((__pid) < IPC_SET_PIDS)				\
+      {							\
+	(__set)[(__pid)>>5] |= (1<<((__pid)&0x1F));	\
+      }							\
+  }
+
+#define IPC_SET_ISIN(__set,__pid)			\
+  ( ((__pid) < IPC_SET_PIDS) ? ((__set)[(__pid)>>5] & (1<<((__pid)&0x1F))) : 0 )
+
+
 /**
 
    Constants: IPC Return Values
@@ -45,12 +107,30 @@
    - IPC_SUCCESS  : All is OK
    - IPC_FAILURE  : Something got wrong
    - IPC_DEADLOCK : A is sending to B which is sending to A
+   - IPC_TIMEOUT  : Timeout expired before the message could be passed
 
 **/
 
 #define IPC_SUCCESS   0
 #define IPC_FAILURE   1
 #define IPC_DEADLOCK  2
+#define IPC_TIMEOUT   3
+
+
+/**
+
+    Constants: IPC timeouts
+    -----------------------
+
+    Timeouts are given in clock ticks, on 24 bits.
+
+    - IPC_TIMEOUT_POLL  : do not block
+    - IPC_TIMEOUT_NEVER : block until the message is passed
+
+**/
+
+#define IPC_TIMEOUT_POLL    0
+#define IPC_TIMEOUT_NEVER   0xFFFFFF
 
 
 /**
@@ -66,6 +146,93 @@
 #define IPC_DATA_LEN  12
 
 
+/**
+
+   Constant: IPC_UTCB_MR
+   ---------------------
+
+   Number of virtual message registers (32 bits words) in an UTCB
+
+**/
+
+#define IPC_UTCB_MR   64
+
+
+/**
+   
+   Structure: struct ipc_utcb
+   --------------------------
+
+   User thread control block: a per thread page holding virtual message registers
+   for long messages. Members are
+   
+   - send_len : number of registers to send along with next message (0 for registers only).
+                Reset by kernel once sent
+   - recv_len : number of registers received with last message
+   - mr       : message registers
+
+**/
+   
+
+PUBLIC struct ipc_utcb
+{
+  u32_t send_len;
+  u32_t recv_len;
+  u32_t mr[IPC_UTCB_MR];
+};
+
+
+
+/**
+
+   Constant: IPC_MAP_GRANT
+   -----------------------
+
+   Flag for `ipc_map` pages count: unmap pages from sender (grant)
+
+**/
+
+#define IPC_MAP_GRANT   0x80000000
+
+
+/**
+
+   Constant: IPC_HANDLE
+   --------------------
+
+   Flag for IPC destinations: the destination is an endpoint handle
+   (as returned by `ipc_handle`) rather than a process id
+
+**/
+
+#define IPC_HANDLE      0x80000000
+
+
+/**
+
+   Constants: IPC_GROUP, IPC_GROUP_PARTIAL
+   ---------------------------------------
+
+   Flags for IPC destinations: the destination is a process group (`ipc_group_send`),
+   and delivery may be partial (members not ready to receive are skipped)
+
+**/
+
+#define IPC_GROUP          0x40000000
+#define IPC_GROUP_PARTIAL  0x20000000
+
+
+/**
+
+   Constant: IPC_GROUPS
+   --------------------
+
+   Number of process groups, with ids from 0 to IPC_GROUPS-1
+
+**/
+
+#define IPC_GROUPS      32
+
 
 /**
    
@@ -89,13 +256,92 @@ PUBLIC struct ipc_message
 
 
 
+/**
+
+   Constant: IPC_BATCH_MAX
+   -----------------------
+
+   Max number of messages in a batch send
+
+**/
+
+#define IPC_BATCH_MAX  64
+
+
+/**
+   
+   Structure: struct ipc_batch
+   ---------------------------
+
+   A batch send entry. Members are
+   
+   - to  : destination (process id or endpoint handle)
+   - msg : message to deliver
+
+**/
+   
+
+PUBLIC struct ipc_batch
+{
+  u32_t to;
+  struct ipc_message msg;
+};
+
+
+
+/**
+
+   Constant: IPC_CHANNEL_REC
+   -------------------------
+
+   Size of a channel record, in 32 bits words (a message content)
+
+**/
+
+#define IPC_CHANNEL_REC  (IPC_DATA_LEN/4)
+
+
+/**
+   
+   Structure: struct ipc_channel
+   -----------------------------
+
+   Single producer, single consumer ring shared by two processes, at the head
+   of the channel pages. Set up by kernel (`ipc_channel`), then used without traps.
+   Members are
+   
+   - head     : records read by consumer (free running, only written by consumer)
+   - tail     : records written by producer (free running, only written by producer)
+   - size     : ring capacity in records (a power of 2)
+   - producer : producer process id, notified when ring goes from full to not full
+   - consumer : consumer process id, notified when ring goes from empty to not empty
+   - rec      : records
+
+**/
+   
+
+PUBLIC struct ipc_channel
+{
+  volatile u32_t head;
+  volatile u32_t tail;
+  u32_t size;
+  u32_t producer;
+  u32_t consumer;
+  u32_t rec[][IPC_CHANNEL_REC];
+};
+
+
+
 /**
 
   Prototypes
   ----------
   
-  Declare the 4 ipc primitives.
-  EXTERN scope due to assembly defintion (lib/ipc/ipc.s)
+  Declare the 5 ipc primitives, their timed variants, receive from a set, pages mapping send, 
+  mailbox activation, UTCB retrieval, endpoint handles management, batch send,
+  channel creation, process groups and receive window.
+  EXTERN scope due to assembly defintion (lib/ipc/ipc.s), except channel records
+  transfer (lib/ipc/channel.c)
 
 **/
 
@@ -103,6 +349,22 @@ EXTERN u8_t ipc_send(int to, struct ipc_message* msg);
 EXTERN u8_t ipc_receive(int from, struct ipc_message* msg);
 EXTERN u8_t ipc_notify(int to);
 EXTERN u8_t ipc_sendrec(int to, struct ipc_message* msg);
+EXTERN u8_t ipc_reply_receive(int to, struct ipc_message* msg);
+EXTERN u8_t ipc_send_timeout(int to, struct ipc_message* msg, u32_t timeout);
+EXTERN u8_t ipc_receive_timeout(int from, struct ipc_message* msg, u32_t timeout);
+EXTERN u8_t ipc_receive_set(u32_t* set, struct ipc_message* msg);
+EXTERN u8_t ipc_map(int to, struct ipc_message* msg);
+EXTERN u8_t ipc_mailbox(void);
+EXTERN struct ipc_utcb* ipc_utcb(void);
+EXTERN int ipc_handle(int pid);
+EXTERN u8_t ipc_handle_close(int handle);
+EXTERN int ipc_send_batch(struct ipc_batch* batch, u32_t n);
+EXTERN u8_t ipc_group(int group, u8_t join);
+EXTERN int ipc_group_send(int group, struct ipc_message* msg, u8_t partial, u32_t* missed);
+EXTERN u8_t ipc_channel(int to, struct ipc_channel* ch, u32_t npages);
+EXTERN u8_t ipc_window(void* base, u32_t npages);
+EXTERN u8_t ipc_channel_put(struct ipc_channel* ch, u32_t* rec);
+EXTERN u8_t ipc_channel_get(struct ipc_channel* ch, u32_t* rec);
 
 
 #endif
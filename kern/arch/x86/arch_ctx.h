@@ -49,7 +49,7 @@ typedef struct x86_context arch_ctx_t;
     Function Pointers
     -----------------
 
-    Glue for arch_ctx_setup
+    Glue for arch_ctx_setup, registers access and syscall return
 
 **/
 
@@ -58,6 +58,7 @@ PRIVATE u8_t (*arch_ctx_setup)(arch_ctx_t* ctx, virtaddr_t base, virtaddr_t stac
 PRIVATE void (*arch_ctx_prepare_switch)(arch_ctx_t* ctx)__attribute__((unused)) = &ctx_prepare_switch;
 PRIVATE void (*arch_ctx_set)(arch_ctx_t* ctx, u8_t r, u32_t value)__attribute__((unused)) = &ctx_set_register;
 PRIVATE u32_t (*arch_ctx_get)(arch_ctx_t* ctx, u8_t r)__attribute__((unused)) = &ctx_get_register;
+PRIVATE u8_t (*arch_ctx_sysexit)(arch_ctx_t* ctx, u8_t fast)__attribute__((unused)) = &ctx_sysexit;
 
 
 #endif
@@ -21,8 +21,9 @@
 
    - define.h
    - types.h
-   - pic.h     : x86 pit functions
-   - x86_lib.h : sti
+   - pic.h     : x86 pic functions
+   - pit.h     : x86 pit functions
+   - x86_lib.h : sti, hlt
  
 **/
 
@@ -30,6 +31,7 @@
 #include <define.h>
 #include <types.h>
 #include "pic.h"
+#include "pit.h"
 #include "x86_lib.h"
 
 
@@ -38,14 +40,18 @@
     Function Pointers
     -----------------
 
-    Glue for pit, sti
+    Glue for pic, pit (one-shot timer), sti, hlt
 
 **/
 
 
 PRIVATE u8_t (*arch_enable_irq)(u8_t n)__attribute__((unused)) = &pic_enable_irq;
 PRIVATE u8_t (*arch_disable_irq)(u8_t n)__attribute__((unused)) = &pic_disable_irq;
+PRIVATE u32_t (*arch_timer_oneshot)(u32_t ticks)__attribute__((unused)) = &pit_oneshot;
+PRIVATE u32_t (*arch_timer_elapsed)(void)__attribute__((unused)) = &pit_elapsed;
+PRIVATE void (*arch_timer_stop)(void)__attribute__((unused)) = &pit_stop;
 PRIVATE void (*arch_sti)(void)__attribute__((unused)) = &x86_sti;
+PRIVATE void (*arch_hlt)(void)__attribute__((unused)) = &x86_hlt;
 
 
 #endif
@@ -37,7 +37,7 @@
     Function Pointers
     -----------------
 
-    Glue for printf, memset and memcopy
+    Glue for printf, memset, memcopy, bit scan and cycle counter
 
 **/
 
@@ -45,5 +45,7 @@
 PRIVATE void (*arch_printf)(const char* str,...)__attribute__((unused)) = &serial_printf;
 PRIVATE void (*arch_memset)(u32_t val, addr_t dest, u32_t len)__attribute__((unused)) = &x86_mem_set;
 PRIVATE void (*arch_memcopy)(addr_t src, addr_t dest, u32_t len)__attribute__((unused)) = &x86_mem_copy;
+PRIVATE u32_t (*arch_bsf)(u32_t val)__attribute__((unused)) = &x86_bsf;
+PRIVATE u32_t (*arch_cycles)(void)__attribute__((unused)) = &x86_rdtsc;
 
 #endif
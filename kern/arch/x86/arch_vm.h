@@ -36,7 +36,9 @@
     Function Pointers
     -----------------
 
-    Glue for address space sync and switch.
+    Glue for address space sync and switch, 
+    kernel and user space un/mapping, user page table creation,
+    user space release and address translation.
 
 **/
 
@@ -44,5 +46,12 @@
 PRIVATE u8_t (*arch_sync_addrspace)(virtaddr_t addrspace)__attribute__((unused)) = &vm_sync;
 PRIVATE u8_t (*arch_switch_addrspace)(virtaddr_t addrspace)__attribute__((unused)) = &vm_switch_to;
 PRIVATE virtaddr_t (*arch_get_addrspace)(void)__attribute__((unused)) = &vm_get_pd;
+PRIVATE u8_t (*arch_map)(virtaddr_t vaddr, physaddr_t paddr)__attribute__((unused)) = &vm_paging_map;
+PRIVATE u8_t (*arch_unmap)(virtaddr_t vaddr)__attribute__((unused)) = &vm_paging_unmap;
+PRIVATE u8_t (*arch_user_map)(virtaddr_t vaddr, physaddr_t paddr)__attribute__((unused)) = &vm_paging_user_map;
+PRIVATE u8_t (*arch_user_unmap)(virtaddr_t vaddr)__attribute__((unused)) = &vm_paging_user_unmap;
+PRIVATE void (*arch_user_release)(u8_t (*release)(physaddr_t paddr))__attribute__((unused)) = &vm_paging_user_release;
+PRIVATE u8_t (*arch_user_table)(virtaddr_t vaddr, physaddr_t paddr)__attribute__((unused)) = &vm_paging_user_table;
+PRIVATE physaddr_t (*arch_tophys)(virtaddr_t vaddr)__attribute__((unused)) = &vm_tophys;
 
 #endif
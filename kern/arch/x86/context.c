@@ -19,6 +19,7 @@
    - x86_const.h
    - x86_lib.h
    - vm_segment.h   : TSS needed
+   - vm_paging.h    : user stack check before SYSEXIT
    - context.h      : self header
 
 **/
@@ -29,6 +30,7 @@
 #include "x86_const.h"
 #include "x86_lib.h"
 #include "vm_segment.h"
+#include "vm_paging.h"
 #include "context.h"
 
 
@@ -250,3 +252,48 @@ PUBLIC u32_t ctx_get_register(struct x86_context* ctx, u8_t r)
   return 0;
   
 }
+
+
+
+/**
+
+   Function: u8_t ctx_sysexit(struct x86_context* ctx, u8_t fast)
+   ---------------------------------------------------------------
+
+   Choose how the syscall saved in `ctx`, which entered through SYSENTER, returns.
+
+   If `fast` (the thread still runs, so its address space is the current one) and 
+   the SYSENTER stub slots on its user stack are mapped, ECX and EDX are stored there,
+   EIP is set to the return address found there and TRUE is returned: `restore_ctx`
+   will leave through SYSEXIT. Otherwise the context is turned into a regular one
+   (return through iretd, registers intact) and FALSE is returned.
+   Nothing is done for a context which did not enter through SYSENTER.
+
+**/
+
+
+PUBLIC u8_t ctx_sysexit(struct x86_context* ctx, u8_t fast)
+{
+  u32_t* slots;
+
+  if (ctx->error_code != CTX_SYSENTER_ERROR)
+    {
+      return FALSE;
+    }
+
+  slots = (u32_t*)ctx->esp;
+
+  if ( (!fast)
+       || (ctx->esp < X86_CONST_KERN_HIGHMEM) || (ctx->esp + CTX_SYSEXIT_SLOTS*sizeof(u32_t) - 1 < ctx->esp)
+       || (!vm_tophys(ctx->esp)) || (!vm_tophys(ctx->esp + CTX_SYSEXIT_SLOTS*sizeof(u32_t) - 1)) )
+    {
+      ctx->error_code = CTX_FAKE_ERROR;
+      return FALSE;
+    }
+
+  slots[0] = ctx->ecx;
+  slots[1] = ctx->edx;
+  ctx->eip = slots[2];
+
+  return TRUE;
+}
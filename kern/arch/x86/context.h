@@ -41,6 +41,34 @@
 #define CTX_EDX        5
 
 
+/**
+
+   Constants: Context error codes
+   ------------------------------
+
+   Error code slot of a context saved by a syscall: CTX_SYSENTER_ERROR if it 
+   entered through SYSENTER (it may return through SYSEXIT), CTX_FAKE_ERROR otherwise.
+   Values match the ones pushed in int.s.
+
+**/
+
+#define CTX_FAKE_ERROR      0xFEC
+#define CTX_SYSENTER_ERROR  0x5E5E5E5E
+
+
+/**
+
+   Constant: CTX_SYSEXIT_SLOTS
+   ---------------------------
+
+   Words left by the SYSENTER user stub on top of its stack: slots for ECX and EDX
+   (clobbered by SYSEXIT), then the address SYSEXIT returns to.
+
+**/
+
+#define CTX_SYSEXIT_SLOTS   3
+
+
 /**
 
    Structure: struct context
@@ -81,7 +109,7 @@ PUBLIC struct x86_context
    Prototypes
    ----------
 
-    Give access to context setup, context post save and switch.
+    Give access to context setup, context post save, switch and SYSEXIT return.
 
 **/
 
@@ -90,6 +118,7 @@ PUBLIC void ctx_postsave(struct x86_context* ctx, reg32_t* esp);
 PUBLIC void ctx_prepare_switch(struct x86_context* ctx);
 PUBLIC void ctx_set_register(struct x86_context* ctx, u8_t r, u32_t value);
 PUBLIC u32_t ctx_get_register(struct x86_context* ctx, u8_t r);
+PUBLIC u8_t ctx_sysexit(struct x86_context* ctx, u8_t fast);
 
 
 #endif
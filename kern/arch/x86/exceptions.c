@@ -19,6 +19,7 @@
    - context.h     : CPU context
    - vm_paging.h   : page fault error codes
    - x86_lib.h
+   - pager0.h      : physical pages allocation
    - exceptions.h  : self header
 
 **/
@@ -30,6 +31,7 @@
 #include "context.h"
 #include "vm_paging.h"
 #include "x86_lib.h"
+#include "pager0.h"
 #include "exceptions.h"
 
 
@@ -44,22 +46,32 @@
 **/
 
 
-physaddr_t p=4096;
-
 PUBLIC void excep_handle(u32_t num, struct x86_context* ctx)
 {
 
   u8_t type;
+  physaddr_t p;
   
   if (num == 14)
     {
       serial_printf("PF - ");
+
+      /* Physical page from pager0, so explicit allocations never get the same one */
+      p = pager0_alloc();
+      if (p == PAGER0_ERROR)
+	{
+	  serial_printf("no physical page left !\n");
+	  while(1){}
+	}
+
       type = vm_pf_resolvable(ctx);
       serial_printf("type %u -(0x%x will be mapped to 0x%x)\n",type,x86_get_pf_addr(),p);  
       type |= VM_PF_RW;
       //type |= VM_PF_SUPER;
-      vm_pf_fix(x86_get_pf_addr(), p, type);
-      p += 4096;
+      if (vm_pf_fix(x86_get_pf_addr(), p, type) != EXIT_SUCCESS)
+	{
+	  pager0_free(p);
+	}
 
     }
   else
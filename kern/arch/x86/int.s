@@ -39,6 +39,7 @@ global	hwint_14
 global	hwint_15
 
 global	swint_syscall
+global	sysenter_syscall
 	
 global	excep_00
 global	excep_01
@@ -71,6 +72,7 @@ global	excep_18
 	;;	- excep_handle		: exception generic handler
 	;; 	- ctx_postsave	        : helper to save context in case of ring jump
 	;; 	- syscall_handle	: syscall generic handler
+	;; 	- syscall_fastpath	: syscall fast path
 	;; 
 	;;**/
 	
@@ -80,6 +82,7 @@ extern	ctx_postsave
 extern  cur_th
 	
 extern	syscall_handle
+extern	syscall_fastpath
 
 
 	;;/**
@@ -93,6 +96,8 @@ extern	syscall_handle
 %assign		KERN_DS_SELECTOR		16 ; DS  = 00000010  0  00   = (byte) 16
 %assign		KERN_ES_SELECTOR		16 ; ES  = 00000010  0  00   = (byte) 16
 %assign		KERN_SS_SELECTOR		16 ; SS  = 00000010  0  00   = (byte) 16
+%assign		USER_CS_SELECTOR		27 ; CS  = 00000011  0  11   = (byte) 27
+%assign		USER_SS_SELECTOR		35 ; SS  = 00000100  0  11   = (byte) 35
 	
 	;;/**
 	;; 
@@ -116,6 +121,19 @@ extern	syscall_handle
 	;;**/
 	
 %assign		FAKE_ERROR		0xFEC
+
+
+	;;/**
+	;; 
+	;; 	Constant: SYSENTER Error Code
+	;;	-----------------------------
+	;;
+	;; 	Error code pushed by the SYSENTER entry instead of the fake one.
+	;; 	A context restored with it returns through SYSEXIT (see `ctx_sysexit`).
+	;;
+	;;**/
+	
+%assign		SYSENTER_ERROR		0x5E5E5E5E
 	
 	;;/**
 	;; 
@@ -124,16 +142,59 @@ extern	syscall_handle
 	;; 
 	;;	Offset of fields:
 	;; 	- ret_addr
-	;; 	- cs
-	;; 	- esp
+	;; 	- error_code, eip, cs, eflags, esp (from ret_addr)
 	;; 	in struct cpu_info
 	;;
 	;;**/
 	
 
 %assign		THREAD_RET_OFFSET		40
+%assign		THREAD_ERROR_OFFSET		4
+%assign		THREAD_EIP_OFFSET		8
 %assign		THREAD_CS_OFFSET		12
+%assign		THREAD_EFLAGS_OFFSET		16
 %assign		THREAD_ESP_OFFSET		20
+
+
+	;;/**
+	;; 
+	;; 	Constants: Message registers offsets
+	;;	------------------------------------
+	;;
+	;;	Offset of message registers in struct x86_context
+	;;
+	;;**/
+
+%assign		CTX_EBX_OFFSET			24
+%assign		CTX_EDX_OFFSET			28
+%assign		CTX_ECX_OFFSET			32
+%assign		CTX_EAX_OFFSET			36
+
+
+	;;/**
+	;; 
+	;; 	Constants: Syscalls
+	;;	-------------------
+	;;
+	;;	Syscalls numbers and return value used by the fast path
+	;;
+	;;**/
+
+%assign		SYSCALL_SENDREC_NUM		4
+%assign		SYSCALL_REPLY_RECEIVE_NUM	5
+%assign		IPC_SUCCESS			0
+
+
+	;;/**
+	;;
+	;; 	Constant: Interrupt flag
+	;; 	------------------------
+	;;
+	;; 	Interrupt flag in EFLAGS
+	;;
+	;;**/
+
+%assign		EFLAGS_IF		0x200
 	
 	;;/**
 	;;
@@ -296,9 +357,118 @@ hwint_15:
 
 swint_syscall:
         push    FAKE_ERROR
+
+swint_syscall_entry:
+	;; Fast path only for sendrec and reply_receive from user space
+	cmp	esi,SYSCALL_SENDREC_NUM
+	je	swint_syscall_fast
+	cmp	esi,SYSCALL_REPLY_RECEIVE_NUM
+	je	swint_syscall_fast
+
+swint_syscall_slow:	
         call    save_ctx
         call    syscall_handle
         call    restore_ctx
+
+
+	;;/**
+	;;
+	;; 	Function: sysenter_syscall
+	;; 	--------------------------
+	;;
+	;; 	SYSENTER entry point. Caller passes its return address in EAX and its stack in EBP.
+	;;
+	;; 	SYSENTER_ESP MSR points to `tss.esp0`, so the current thread kernel stack is retrieved from there.
+	;; 	Then the frame an `int` would have pushed is built (SS, ESP, EFLAGS, CS, EIP), so the
+	;; 	syscall continues exactly like the `int` one and thread context stays the same
+	;; 	for later scheduling switches. 
+	;;
+	;; 	The error code slot is marked with SYSENTER_ERROR: if the caller is still the running
+	;; 	thread at the end of the syscall, `restore_ctx` returns through SYSEXIT (see `ctx_sysexit`).
+	;; 	Otherwise the mark is cleared and the return is done by iretd.
+	;;
+	;;**/
+
+	
+sysenter_syscall:
+	mov	esp,[esp]
+	push	dword USER_SS_SELECTOR
+	push	ebp
+	pushfd
+	or	dword [esp],EFLAGS_IF ; Interrupts are masked by SYSENTER
+	push	dword USER_CS_SELECTOR
+	push	eax
+	push	SYSENTER_ERROR
+	jmp	swint_syscall_entry
+
+	
+	;;/**
+	;;
+	;; 	Function: swint_syscall_fast
+	;; 	----------------------------
+	;;
+	;; 	IPC fast path.
+	;;
+	;; 	Caller comes from user space, so the kernel stack is the end of its context:
+	;; 	registers are pushed right there, without the save_ctx/ctx_postsave round trip.
+	;; 	Then `syscall_fastpath` blocks the caller and switches to the waiting receiver,
+	;; 	whose context gets EBX, ECX and EDX copied directly before returning to it.
+	;; 	If `syscall_fastpath` refuses the call, the regular C handler takes it 
+	;; 	as the context is already saved.
+	;;
+	;;**/
+
+	
+swint_syscall_fast:
+	;; User space caller only
+	test	dword [esp+8],3
+	jz	swint_syscall_slow
+
+	;; Skip ret_addr and save registers in context
+	sub	esp,4
+	pushad
+	o16 push	ds
+	o16 push	es
+	o16 push	fs
+	o16 push	gs
+
+	;; Get on the interrupt stack with kernel segments
+	mov	esp, int_stack_top
+	mov	ax,KERN_DS_SELECTOR
+	mov	ds,ax
+	mov	ax,KERN_ES_SELECTOR
+	mov	es,ax
+
+	;; C code expects direction flag cleared (as done by save_ctx)
+	cld
+
+	;; Keep caller context (EBX is preserved by C code)
+	mov	ebx,[cur_th]
+	
+	push	edi
+	push	esi
+	call	syscall_fastpath
+	add	esp,8
+	test	eax,eax
+	jz	swint_syscall_fast_miss
+
+	;; Caller result
+	mov	dword [ebx+CTX_EAX_OFFSET],IPC_SUCCESS
+
+	;; Copy message from caller to receiver context
+	mov	ecx,dword [ebx+CTX_EBX_OFFSET]
+	mov	dword [eax+CTX_EBX_OFFSET],ecx
+	mov	ecx,dword [ebx+CTX_ECX_OFFSET]
+	mov	dword [eax+CTX_ECX_OFFSET],ecx
+	mov	ecx,dword [ebx+CTX_EDX_OFFSET]
+	mov	dword [eax+CTX_EDX_OFFSET],ecx
+
+	;; Return to receiver
+	jmp	restore_ctx
+	
+swint_syscall_fast_miss:
+	call	syscall_handle
+	call	restore_ctx
 	
 	
 	;;/**
@@ -352,6 +522,8 @@ save_ctx:
 	;;
 	;; 	Restore the context of cur_th thread
 	;; 	It simply pops the registers from the cur_th struct cpu_info
+	;; 	A context marked by the SYSENTER entry (and kept by `ctx_sysexit`)
+	;; 	leaves through SYSEXIT: EIP in EDX, ESP in ECX, IF set in the `sti` shadow.
 	;;
 	;;**/
 
@@ -364,6 +536,9 @@ restore_ctx:
 	o16 pop	ds
 	popad
 
+	cmp	dword [esp+THREAD_ERROR_OFFSET], SYSENTER_ERROR
+	je	restore_ctx_sysexit
+
 	;; In case of an interrupted kernel thread, we move back to the thread stack
 	;; which contains the parameters for itretd					       
 	cmp 	dword [esp+THREAD_CS_OFFSET], KERN_CS_SELECTOR
@@ -375,6 +550,15 @@ restore_ctx_next:
 	add 	esp,4		; pop error code
 	iretd
 
+restore_ctx_sysexit:
+	mov	edx, dword [esp+THREAD_EIP_OFFSET]
+	mov	ecx, dword [esp+THREAD_ESP_OFFSET]
+	push	dword [esp+THREAD_EFLAGS_OFFSET]
+	and	dword [esp], ~EFLAGS_IF	; No interrupt before SYSEXIT
+	popfd
+	sti
+	sysexit
+
 
 	
 	;;/**
@@ -17,6 +17,8 @@
    - define.h
    - types.h
    - x86_const.h
+   - x86_lib.h     : MSR and CPUID access
+   - vm_segment.h  : TSS needed
    - interrupt.h   : self header
 
 **/
@@ -24,6 +26,8 @@
 #include <define.h>
 #include <types.h>
 #include "x86_const.h"
+#include "x86_lib.h"
+#include "vm_segment.h"
 #include "interrupt.h"
 
 
@@ -56,6 +60,22 @@
 #define INT_IDT_SIZE            52
 
 
+/**
+
+   Constants: SYSENTER relatives
+   -----------------------------
+
+   SYSENTER model specific registers and CPUID flag (SEP)
+
+**/
+
+#define INT_MSR_SYSENTER_CS     0x174
+#define INT_MSR_SYSENTER_ESP    0x175
+#define INT_MSR_SYSENTER_EIP    0x176
+
+#define INT_CPUID_SEP           (1<<11)
+
+
 /**
 
    Externs
@@ -83,6 +103,7 @@ EXTERN void hwint_14(void);
 EXTERN void hwint_15(void);
 
 EXTERN void swint_syscall(void);
+EXTERN void sysenter_syscall(void);
 
 EXTERN void excep_00(void);
 EXTERN void excep_01(void);
@@ -205,7 +226,7 @@ PRIVATE void create_gate_desc(struct gate_desc* gate, u16_t seg, u32_t off);
 
    Initiliaze interrupt system
 
-   Create IDT
+   Create IDT and set up SYSENTER entry point
 
 **/
 
@@ -258,6 +279,16 @@ PUBLIC u8_t interrupt_setup(void)
   /* Syscall handler */
   create_int_gate(&idt[50], X86_CONST_KERN_CS_SELECTOR, (lineaddr_t)swint_syscall, INT_SEG_PRESENT | INT_SEG_DPL_3);
 
+  /* SYSENTER syscall handler, if supported (int 50 remains) */
+  if (x86_cpuid_features() & INT_CPUID_SEP)
+    {
+      /* GDT layout fits SYSENTER/SYSEXIT: kernel CS, kernel SS, user CS, user SS */
+      x86_wrmsr(INT_MSR_SYSENTER_CS, X86_CONST_KERN_CS_SELECTOR, 0);
+      /* ESP points to `tss.esp0`, which holds the current thread kernel stack */
+      x86_wrmsr(INT_MSR_SYSENTER_ESP, (lineaddr_t)&tss.esp0, 0);
+      x86_wrmsr(INT_MSR_SYSENTER_EIP, (lineaddr_t)sysenter_syscall, 0);
+    }
+
   return EXIT_SUCCESS;
 }
 
@@ -36,6 +36,8 @@
    Constants: PIT Frequency relatives
    ----------------------------------
 
+   PIT_FREQ is the tick rate, one-shots are programmed in ticks
+
 **/
 
 #define PIT_MAX_FREQ     1193182
@@ -57,16 +59,18 @@
 
 /**
 
-   Constant: PIT_MODE2
+   Constant: PIT_MODE0
    -------------------
 
-   Control word to set mode 2.
-   Mode 2 is Rate Generator: Output line is set to 1 every n clock pulsation, where n is the counter value.
-   In other word, an interrupt is triggered at rate 1193182/n Hz
+   Control word to set mode 0.
+   Mode 0 is Interrupt on Terminal Count: counter starts once its value is written and
+   output line is set to 1 when it reaches 0, triggering a single interrupt (one-shot).
+   Writing control word alone sets output line to 0 and stops counting until
+   a new value is written.
 
 **/   
 
-#define PIT_MODE2        0x34   /* 0x34=00110100b, Mode 2 pour le compteur 0 */
+#define PIT_MODE0        0x30   /* 0x30=00110000b, Mode 0 for counter 0 */
 
 
 /**
@@ -90,6 +94,52 @@
 #define PIT_LATCH        0x00   /* 00000000b Counter Latch pour le compteur 0 */
 
 
+/**
+   
+   Constants: PIT_READBACK & PIT_STATUS_OUT
+   ----------------------------------------
+
+   Read-Back command latching both status and count of counter 0. 
+   Status byte is read first, then count (LSB then MSB).
+   Bit 7 of status is the output line state: set once a one-shot has expired.
+
+**/
+
+#define PIT_READBACK     0xC2   /* 11000010b Read-Back status and count of counter 0 */
+#define PIT_STATUS_OUT   0x80
+
+
+/**
+
+   Constants: One-shot limits
+   --------------------------
+
+   Clock pulsations in a tick, maximum whole ticks in a single one-shot
+   and longest one-shot in pulsations (counter is 16 bits, 65536 is 0)
+
+**/
+
+#define PIT_TICK_PULSES  (PIT_MAX_FREQ/PIT_FREQ)
+#define PIT_MAX_TICKS    (65536/PIT_TICK_PULSES)
+#define PIT_MAX_PULSES   65536
+
+
+/**
+
+   Privates
+   --------
+
+   Current one-shot length and pulsations of it already accounted (in clock pulsations).
+   Pulsations accounted but not yet returned as ticks by `pit_elapsed`.
+
+**/
+
+PRIVATE u32_t pit_shot;
+PRIVATE u32_t pit_seen;
+PRIVATE u32_t pit_pulses;
+
+PRIVATE void pit_account(void);
+
 
 /**
 
@@ -97,32 +147,166 @@
    -----------------------------
 
    Programmable Interval Timer initialization.
-   Configure clock mode and frequency.
+   Configure one-shot mode and arm a first tick.
 
 **/
 
 PUBLIC u8_t pit_setup(void)
+{
+  pit_shot = 0;
+  pit_seen = 0;
+  pit_pulses = 0;
+
+  pit_oneshot(1);
+  
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u32_t pit_oneshot(u32_t ticks)
+   ----------------------------------------
+
+   Program a single interrupt in `ticks` ticks, once elapsed time of the current one-shot
+   is accounted. Above `PIT_MAX_TICKS`, the whole counter is used (about 55ms at 100Hz),
+   last tick being partial. Elapsed pulsations are accounted anyway, so no time is lost.
+
+   Return ticks really programmed, a partial last tick counting as a whole one.
+
+**/
+
+PUBLIC u32_t pit_oneshot(u32_t ticks)
+{
+  u32_t count;
+
+  pit_account();
+
+  if (!ticks)
+    {
+      ticks = 1;
+    }
+
+  if (ticks > PIT_MAX_TICKS)
+    {
+      /* Longest one-shot, partial last tick rounded up */
+      pit_shot = PIT_MAX_PULSES;
+      ticks = (PIT_MAX_PULSES + PIT_TICK_PULSES - 1)/PIT_TICK_PULSES;
+    }
+  else
+    {
+      pit_shot = ticks*PIT_TICK_PULSES;
+    }
+  pit_seen = 0;
+
+  /* 65536 == 0 */
+  count = (pit_shot==PIT_MAX_PULSES?0:pit_shot);
+
+  /* Send control word to active Mode 0 (one-shot) */
+  x86_outb(PIT_CWREG,PIT_MODE0);
+
+  /* Send count */
+  x86_outb(PIT_COUNTER0,(u8_t)count);        /* LSB first */
+  x86_outb(PIT_COUNTER0,(u8_t)(count>>8));   /* MSB last */
+
+  return ticks;
+}
+
+
+/**
+
+   Function: void pit_stop(void)
+   -----------------------------
+
+   Stop counter 0 once elapsed time of the current one-shot is accounted:
+   writing the mode 0 control word alone stops counting, so no interrupt comes
+   until `pit_oneshot` writes a new count. Time is not counted while stopped.
+
+**/
+
+PUBLIC void pit_stop(void)
+{
+  pit_account();
+
+  pit_shot = 0;
+  pit_seen = 0;
+
+  /* Control word alone: output low, counting stopped */
+  x86_outb(PIT_CWREG,PIT_MODE0);
+
+  return;
+}
+
+
+/**
+
+   Function: u32_t pit_elapsed(void)
+   ---------------------------------
+
+   Return ticks elapsed since last call.
+   Remaining pulsations are kept for next calls, so no time is lost.
+
+**/
+
+PUBLIC u32_t pit_elapsed(void)
 {
   u32_t ticks;
 
-  /* Compute number of clock pulsations before triggering interrupt */
-  ticks = PIT_MAX_FREQ/PIT_FREQ;
+  pit_account();
 
-  /* counter are 16 bits values
-     max value is 2^16=65535 and 65536 is in fact 0 */
-   
-  if (ticks <= 65536)
+  ticks = pit_pulses/PIT_TICK_PULSES;
+  pit_pulses %= PIT_TICK_PULSES;
+
+  return ticks;
+}
+
+
+/**
+
+   Function: void pit_account(void)
+   --------------------------------
+
+   Read counter 0 and accumulate pulsations elapsed in current one-shot since last read.
+   Once output line is set, counter has wrapped from 0 and keeps going down.
+
+**/
+
+PRIVATE void pit_account(void)
+{
+  u8_t status,lsb,msb;
+  u32_t count,done;
+
+  if (!pit_shot)
     {
-      /* 65536 == 0 */
-      ticks = (ticks==65536?0:ticks);
+      return;
+    }
 
-      /* Send control word to active Mode 2 (Rate Generator) */
-      x86_outb(PIT_CWREG,PIT_MODE2);
+  x86_outb(PIT_CWREG,PIT_READBACK);
+  x86_inb(PIT_COUNTER0,&status);
+  x86_inb(PIT_COUNTER0,&lsb);
+  x86_inb(PIT_COUNTER0,&msb);
+  count = ((u32_t)msb << 8)|lsb;
 
-      /* Send frequency for this mode */
-      x86_outb(PIT_COUNTER0,(u8_t)ticks);        /* LSB first */
-      x86_outb(PIT_COUNTER0,(u8_t)(ticks>>8));   /* MSB last */
+  if (status & PIT_STATUS_OUT)
+    {
+      /* Expired: whole shot plus time since wrap */
+      done = pit_shot + ((65536 - count) & 0xFFFF);
     }
-  
-  return EXIT_SUCCESS;
+  else
+    {
+      /* Running: programmed minus remaining (0 is 65536 right after load) */
+      if (!count)
+	{
+	  count = PIT_MAX_PULSES;
+	}
+      done = (count <= pit_shot ? pit_shot - count : 0);
+    }
+
+  if (done > pit_seen)
+    {
+      pit_pulses += done - pit_seen;
+      pit_seen = done;
+    }
+
+  return;
 }
@@ -32,10 +32,13 @@
    Prototypes 
    ----------
 
-   Give acces to PIT intialization and reads/
+   Give acces to PIT intialization, one-shot programming and elapsed ticks reads
 
 **/
 
 PUBLIC u8_t pit_setup();
+PUBLIC u32_t pit_oneshot(u32_t ticks);
+PUBLIC u32_t pit_elapsed(void);
+PUBLIC void pit_stop(void);
 
 #endif
@@ -78,7 +78,7 @@ PUBLIC void setup_x86(u32_t magic, physaddr_t mbi_addr)
   size_t bitmap_size,vm_stack_size;
   u32_t mem=0;
   struct boot_mmap_entry* mmap;
-  physaddr_t bitmap,limit,vm_stack;
+  physaddr_t bitmap,refcount,limit,vm_stack;
 
   /* Initialize serial port */
   serial_init();
@@ -158,6 +158,11 @@ PUBLIC void setup_x86(u32_t magic, physaddr_t mbi_addr)
   /* Update first available byte */
   limit +=  (((bitmap_size >> X86_CONST_PAGE_SHIFT)+1) << X86_CONST_PAGE_SHIFT);
 
+  /* Reserve reference counts, one byte per page */
+  refcount = limit;
+  /* Update first available byte */
+  limit +=  (((((bitmap_size+1) << 3) >> X86_CONST_PAGE_SHIFT)+1) << X86_CONST_PAGE_SHIFT);
+
 
   /* Compute virtual pages stack size */
   vm_stack_size = (X86_CONST_KERN_HIGHMEM >> X86_CONST_PAGE_SHIFT);
@@ -210,6 +215,7 @@ PUBLIC void setup_x86(u32_t magic, physaddr_t mbi_addr)
   boot.mmap_addr = mbi.mmap_addr;
   boot.bitmap = bitmap;
   boot.bitmap_size = bitmap_size;
+  boot.refcount = refcount;
   boot.vm_stack = vm_stack;
   boot.vm_stack_size = vm_stack_size;
   boot.start = limit;
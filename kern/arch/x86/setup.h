@@ -62,7 +62,7 @@
 **/
 
 #define MULTIBOOT_MMAP_MAX       128
-#define MULTIBOOT_MODS_COUNT     3
+#define MULTIBOOT_MODS_COUNT     4
 
 
 
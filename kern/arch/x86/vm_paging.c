@@ -200,19 +200,6 @@ PUBLIC struct pde* kern_pd;
 
 
 
-/**
-
-   Privates
-   --------
-
-   Virtual to physical address conversion
-
-**/
-
-
-PRIVATE physaddr_t vm_tophys(virtaddr_t vaddr);
-
-
 /**
 
    Function: u8_t paging_setup(physaddr_t base, physaddr_t limit)
@@ -392,6 +379,9 @@ PUBLIC u8_t vm_paging_unmap(virtaddr_t vaddr)
   table[pte].user=0;
   table[pte].baseaddr=0;
 
+  /* Flush stale translation */
+  x86_invlpg(vaddr);
+
   return EXIT_SUCCESS;
 	   
 }
@@ -626,18 +616,191 @@ PUBLIC u8_t vm_pf_fix(virtaddr_t vaddr, physaddr_t paddr, u8_t flag)
 
 
 
+/** 
+    
+    Function: u8_t vm_paging_user_map(virtaddr_t vaddr, physaddr_t paddr)
+    ---------------------------------------------------------------------
+
+    Point user page `vaddr` of current address space to `paddr`, 
+    replacing any existing mapping. Page table must exist.
+
+**/
+
+
+PUBLIC u8_t vm_paging_user_map(virtaddr_t vaddr, physaddr_t paddr)
+{
+  struct pde* pd;
+  struct pte* table;
+  u16_t pde,pte;
+
+  /* Get current page directory, page directory entry and page table entry linked to `vaddr` */ 
+  pde = VM_PAGING_GET_PDE(vaddr);
+  pte = VM_PAGING_GET_PTE(vaddr);
+  pd = (struct pde*)VM_PAGING_GET_PD();
+
+  /* Kernel space, self map and page table checks */
+  if ( (vaddr < X86_CONST_KERN_HIGHMEM) || (pde == VM_PAGING_SELFMAP) || (!(pd[pde].present)) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* Drop previous mapping */
+  table = (struct pte*)VM_PAGING_GET_PT(pde);
+  if (table[pte].present)
+    {
+      table[pte].present = 0;
+      x86_invlpg(vaddr);
+    }
+
+  /* Map as a page fault fix would do */
+  return vm_pf_fix(vaddr,paddr,VM_PF_EXTERNAL|VM_PF_RW);
+}
+
+
+
+/** 
+    
+    Function: u8_t vm_paging_user_table(virtaddr_t vaddr, physaddr_t paddr)
+    -----------------------------------------------------------------------
+
+    Create page table covering user page `vaddr` of current address space
+    in physical page `paddr`. Fail if that page table already exists.
+
+**/
+
+
+PUBLIC u8_t vm_paging_user_table(virtaddr_t vaddr, physaddr_t paddr)
+{
+  struct pde* pd;
+  u16_t pde;
+
+  /* Get current page directory and page directory entry linked to `vaddr` */ 
+  pde = VM_PAGING_GET_PDE(vaddr);
+  pd = (struct pde*)VM_PAGING_GET_PD();
+
+  /* Kernel space, self map and page table checks */
+  if ( (vaddr < X86_CONST_KERN_HIGHMEM) || (pde == VM_PAGING_SELFMAP) || (pd[pde].present) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* Create it as a page fault fix would do */
+  return vm_pf_fix(vaddr,paddr,VM_PF_INTERNAL|VM_PF_RW);
+}
+
+
+
+/** 
+    
+    Function: u8_t vm_paging_user_unmap(virtaddr_t vaddr)
+    -----------------------------------------------------
+
+    Remove user page `vaddr` mapping in current address space
+
+**/
+
+
+PUBLIC u8_t vm_paging_user_unmap(virtaddr_t vaddr)
+{
+  struct pde* pd;
+  struct pte* table;
+  u16_t pde,pte;
+
+  /* Get current page directory, page directory entry and page table entry linked to `vaddr` */ 
+  pde = VM_PAGING_GET_PDE(vaddr);
+  pte = VM_PAGING_GET_PTE(vaddr);
+  pd = (struct pde*)VM_PAGING_GET_PD();
+
+  /* Kernel space, self map and page table checks */
+  if ( (vaddr < X86_CONST_KERN_HIGHMEM) || (pde == VM_PAGING_SELFMAP) || (!(pd[pde].present)) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  table = (struct pte*)VM_PAGING_GET_PT(pde);
+  if (!table[pte].present)
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* Nullify entry and flush translation */
+  table[pte].present=0;
+  table[pte].rw=0;
+  table[pte].user=0;
+  table[pte].baseaddr=0;
+  x86_invlpg(vaddr);
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+    Function: void vm_paging_user_release(u8_t (*release)(physaddr_t paddr))
+    ------------------------------------------------------------------------
+
+    Remove every user mapping of current address space, and its page tables.
+    Physical pages behind them, page tables included, are handed to `release`.
+
+**/
+
+
+PUBLIC void vm_paging_user_release(u8_t (*release)(physaddr_t paddr))
+{
+  struct pde* pd;
+  struct pte* table;
+  u16_t i,j;
+
+  pd = (struct pde*)VM_PAGING_GET_PD();
+
+  /* User page tables (kernel ones are shared, self map is not a table) */
+  for(i=X86_CONST_KERN_HIGHMEM/X86_CONST_PAGE_SIZE/VM_PAGING_ENTRIES;i<VM_PAGING_SELFMAP;i++)
+    {
+      if (!pd[i].present)
+	{
+	  continue;
+	}
+
+      table = (struct pte*)VM_PAGING_GET_PT(i);
+      for(j=0;j<VM_PAGING_ENTRIES;j++)
+	{
+	  if (table[j].present)
+	    {
+	      release(table[j].baseaddr << VM_PAGING_BASESHIFT);
+	      table[j].present=0;
+	      table[j].rw=0;
+	      table[j].user=0;
+	      table[j].baseaddr=0;
+	      x86_invlpg(((virtaddr_t)i << VM_PAGING_DIRSHIFT)|((virtaddr_t)j << VM_PAGING_TBLSHIFT));
+	    }
+	}
+
+      release(pd[i].baseaddr << VM_PAGING_BASESHIFT);
+      pd[i].present=0;
+      pd[i].rw=0;
+      pd[i].user=0;
+      pd[i].baseaddr=0;
+      x86_invlpg((virtaddr_t)table);
+    }
+
+  return;
+}
+
+
+
 /**
    
    Function: physaddr_t vm_tophys(virtaddr_t vaddr)
    ------------------------------------------------
 
-   Return the physical address mapped to `vaddr`. 
+   Return the physical address mapped to `vaddr` in current address space. 
    If such a mapping does not exist, return 0.
 
 **/
 
 
-PRIVATE physaddr_t vm_tophys(virtaddr_t vaddr)
+PUBLIC physaddr_t vm_tophys(virtaddr_t vaddr)
 {
   struct pde* pd;
   struct pte* table;
@@ -68,7 +68,7 @@
    Prototypes
    ----------
 
-   Give access to paging setup and un/mapping
+   Give access to paging setup, un/mapping and address translation
 
 **/
 
@@ -80,5 +80,10 @@ PUBLIC u8_t vm_switch_to(virtaddr_t pd_addr);
 PUBLIC u8_t vm_sync(virtaddr_t pd_addr);
 PUBLIC u8_t vm_pf_resolvable(struct x86_context* ctx);
 PUBLIC u8_t vm_pf_fix(virtaddr_t vaddr, physaddr_t paddr, u8_t flag);
+PUBLIC u8_t vm_paging_user_map(virtaddr_t vaddr, physaddr_t paddr);
+PUBLIC u8_t vm_paging_user_table(virtaddr_t vaddr, physaddr_t paddr);
+PUBLIC u8_t vm_paging_user_unmap(virtaddr_t vaddr);
+PUBLIC void vm_paging_user_release(u8_t (*release)(physaddr_t paddr));
+PUBLIC physaddr_t vm_tophys(virtaddr_t vaddr);
 
 #endif
@@ -73,5 +73,11 @@ EXTERN void x86_mem_set(u32_t val, addr_t dest, size_t len);
 EXTERN void x86_load_pd(physaddr_t pd);
 EXTERN virtaddr_t x86_get_pf_addr(void);
 EXTERN void x86_sti(void);
+EXTERN void x86_wrmsr(u32_t msr, u32_t low, u32_t high);
+EXTERN u32_t x86_cpuid_features(void);
+EXTERN void x86_invlpg(virtaddr_t vaddr);
+EXTERN u32_t x86_bsf(u32_t val);
+EXTERN void x86_hlt(void);
+EXTERN u32_t x86_rdtsc(void);
 
 #endif
@@ -30,6 +30,12 @@ global x86_mem_set
 global x86_load_pd
 global x86_get_pf_addr
 global x86_sti
+global x86_wrmsr
+global x86_cpuid_features
+global x86_invlpg
+global x86_bsf
+global x86_hlt
+global x86_rdtsc
 	
 	;;/**
 	;;
@@ -205,4 +211,137 @@ x86_sti:
 	pop	esi
 	mov	esp,ebp
 	pop	ebp
-	ret
\ No newline at end of file
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: void x86_wrmsr(u32_t msr, u32_t low, u32_t high)
+	;; 	----------------------------------------------------------
+	;;
+	;; 	Write `high`:`low` into model specific register `msr`
+	;;
+	;;**/
+
+
+x86_wrmsr:
+	push 	ebp
+	mov  	ebp,esp
+	push	esi
+	push	edi
+	mov	ecx,[ebp+8]	; Get `msr`
+	mov	eax,[ebp+12]	; Get `low`
+	mov	edx,[ebp+16]	; Get `high`
+	wrmsr			; Write MSR
+	pop	edi
+	pop	esi
+	mov	esp,ebp
+	pop	ebp
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: u32_t x86_cpuid_features(void)
+	;; 	----------------------------------------
+	;;
+	;; 	Return processor features flags (EDX of CPUID leaf 1)
+	;;
+	;;**/
+
+
+x86_cpuid_features:
+	push 	ebp
+	mov  	ebp,esp
+	push	esi
+	push	edi
+	push	ebx		; Trashed by CPUID
+	mov	eax,1		; Leaf 1 : features
+	cpuid
+	mov	eax,edx		; Return features flags
+	pop	ebx
+	pop	edi
+	pop	esi
+	mov	esp,ebp
+	pop	ebp
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: void x86_invlpg(virtaddr_t vaddr)
+	;; 	-------------------------------------------
+	;;
+	;; 	Invalidate TLB entry of page containing `vaddr`
+	;;
+	;;**/
+
+
+x86_invlpg:
+	push 	ebp
+	mov  	ebp,esp
+	mov	eax,[ebp+8]	; Get `vaddr`
+	invlpg	[eax]		; Invalidate
+	mov	esp,ebp
+	pop	ebp
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: u32_t x86_bsf(u32_t val)
+	;; 	----------------------------------
+	;;
+	;; 	Return index of the least significant bit set in `val`
+	;; 	(undefined if `val` is 0)
+	;;
+	;;**/
+
+
+x86_bsf:
+	push 	ebp
+	mov  	ebp,esp
+	bsf	eax,[ebp+8]	; Scan `val`
+	mov	esp,ebp
+	pop	ebp
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: void x86_hlt(void)
+	;; 	----------------------------
+	;;
+	;; 	Halt processor until next interrupt using `hlt`
+	;;
+	;;**/
+
+
+x86_hlt:
+	push 	ebp
+	mov  	ebp,esp
+	hlt			; Wait for an interrupt
+	mov	esp,ebp
+	pop	ebp
+	ret
+
+
+	;;/**
+	;; 
+	;; 	Function: u32_t x86_rdtsc(void)
+	;; 	-------------------------------
+	;;
+	;; 	Return the low 32 bits of the time stamp counter (CPU cycles)
+	;;
+	;;**/
+
+
+x86_rdtsc:
+	push 	ebp
+	mov  	ebp,esp
+	push	edx
+	rdtsc			; EDX:EAX = cycles
+	pop	edx
+	mov	esp,ebp
+	pop	ebp
+	ret
@@ -55,6 +55,7 @@
    - mmap_addr     : Memory map address
    - bitmap        : Physical pages  bitmap
    - bitmap_size   : Bitmap size
+   - refcount      : Physical pages reference counts (one byte per page)
    - vm_stack      : Kernel virtual pages stack
    - vm_stack_size : Stack size
    - start         : First available byte after kernel
@@ -70,6 +71,7 @@ PUBLIC struct boot_info
   addr_t mmap_addr;
   addr_t bitmap;
   size_t bitmap_size;
+  addr_t refcount;
   addr_t vm_stack;
   size_t vm_stack_size;
   addr_t start; 
@@ -17,9 +17,11 @@
 
    - define.h
    - types.h
+   - arch_hw.h : one-shot timer
    - irq.h     : irq_node needed
    - thread.h  : thread switch needed
    - sched.h   : scheduler needed
+   - syscall.h : IPC timeouts expiry
    - clock.h   : self header
 
 **/
@@ -29,12 +31,26 @@
 #include <types.h>
 #include <arch_io.h>
 #include <arch_vm.h>
+#include <arch_hw.h>
 #include "irq.h"
 #include "thread.h"
 #include "sched.h"
+#include "syscall.h"
 #include "clock.h"
 
 
+/**
+
+   Constant: CLOCK_DUMP_TICKS
+   --------------------------
+
+   Ticks between two scheduler and IPC statistics dumps (10s at 100Hz)
+
+**/
+
+#define CLOCK_DUMP_TICKS      1000
+
+
 /**
 
    Private: void clock_handler(void)
@@ -60,6 +76,48 @@ PRIVATE void clock_handler(void);
 static struct irq_node clock_irq_node;
 
 
+/**
+
+   Static: clock_ticks
+   -------------------
+
+   Ticks since clock setup
+
+**/
+
+static u32_t clock_ticks;
+
+
+/**
+
+   Statics: Dynamic tick state
+   ---------------------------
+
+   - clock_charged : ticks when running thread quantum was last charged
+   - clock_expiry  : tick when programmed one-shot expires
+   - clock_stopped : timer stopped while idle (no one-shot programmed)
+   - clock_dump    : tick of next scheduler statistics dump
+
+**/
+
+static u32_t clock_charged;
+static u32_t clock_expiry;
+static u8_t clock_stopped;
+static u32_t clock_dump;
+
+
+/**
+
+   Private: u32_t clock_next(void)
+   -------------------------------
+
+   Ticks until next needed interrupt
+
+**/
+
+
+PRIVATE u32_t clock_next(void);
+
 
 /**
 
@@ -68,7 +126,8 @@ static struct irq_node clock_irq_node;
 
    Set up the clock
 
-   Create an `irq_node` for IRQ 0
+   Create an `irq_node` for IRQ 0. Timer is left with the first one-shot 
+   programmed by architecture setup.
 
 **/
 
@@ -76,6 +135,11 @@ PUBLIC u8_t clock_setup(void)
 {
 
   /* Create an irq node to setup handler */
+  clock_ticks = 0;
+  clock_charged = 0;
+  clock_expiry = 1;
+  clock_stopped = FALSE;
+  clock_dump = CLOCK_DUMP_TICKS;
   clock_irq_node.flih = clock_handler;
   irq_add_flih(0,&clock_irq_node);
 
@@ -83,13 +147,73 @@ PUBLIC u8_t clock_setup(void)
 }
 
 
+/**
+
+   Function: u32_t clock_get_ticks(void)
+   -------------------------------------
+
+   Return ticks since clock setup, including ticks elapsed in current one-shot
+
+**/
+
+PUBLIC u32_t clock_get_ticks(void)
+{
+  clock_ticks += arch_timer_elapsed();
+  return clock_ticks;
+}
+
+
+/**
+
+   Function: void clock_reprogram(void)
+   ------------------------------------
+
+   Called when scheduling state changed outside clock interrupt (end of syscall).
+   Timer is reprogrammed only if an interrupt is needed before the programmed one,
+   or if it was stopped while idle and a wakeup now needs one.
+   Otherwise programmed one-shot will do.
+
+**/
+
+PUBLIC void clock_reprogram(void)
+{
+  u32_t next;
+
+  next = clock_next();
+  if (!next)
+    {
+      return;
+    }
+
+  if ( (!clock_stopped) && ((s32_t)(clock_ticks + next - clock_expiry) >= 0) )
+    {
+      return;
+    }
+
+  /* Catch up time elapsed in current one-shot, then program a sooner one */
+  clock_ticks += arch_timer_elapsed();
+  next = clock_next();
+  clock_expiry = clock_ticks + arch_timer_oneshot(next ? next : 1);
+  clock_stopped = FALSE;
+
+  return;
+}
+
+
+
 /**
  
    Function:  void clock_handler(void)
    ------------------------------------
 
-   First level interrupt handler in charge of clock.
-   For the moment, just call the scheduler.
+   First level interrupt handler in charge of clock (dynamic tick).
+   Count ticks elapsed since last interrupt, expire IPC timeouts and charge running 
+   thread quantum. Scheduler is only called when quantum is used up or a higher priority
+   thread is ready.
+
+   Timer is then programmed as a one-shot for the nearest of quantum end and IPC deadline,
+   If there is none (idle thread running, no timeout), timer is stopped until
+   `clock_reprogram` re-arms it on next wakeup. Idle time is not counted meanwhile.
 
 **/
 
@@ -97,21 +221,78 @@ PRIVATE void clock_handler()
 {
 
   struct thread* th;
+  u32_t next;
+
+  /* Ticks */
+  clock_ticks += arch_timer_elapsed();
+  syscall_expire(clock_ticks);
 
-  /* Scheduler */
-  th = sched_elect();
-  if (th)
+  /* Scheduler: charge ticks to running thread, elect only if needed */
+  if (sched_tick(cur_th,clock_ticks - clock_charged))
     {
-      arch_printf("Elected: %s\n", th->name);
+      th = sched_elect();
+      if ( (th) && (th != cur_th) )
+	{
+	  arch_printf("Elected: %s\n", th->name);
+	}
+      sched_switch(th,FALSE);
     }
-  
-  /* Change address space */
-  if (th->proc)
+  clock_charged = clock_ticks;
+
+  /* Periodic scheduler and IPC statistics */
+  if ((s32_t)(clock_ticks - clock_dump) >= 0)
     {
-      arch_switch_addrspace(th->proc->addrspace);
-    }  
+      sched_dump();
+      syscall_dump();
+      clock_dump = clock_ticks + CLOCK_DUMP_TICKS;
+    }
 
-  thread_switch_to(th);
+  /* Next one-shot, or stop timer until next wakeup if idle */
+  next = clock_next();
+  if (next)
+    {
+      clock_expiry = clock_ticks + arch_timer_oneshot(next);
+      clock_stopped = FALSE;
+    }
+  else
+    {
+      arch_timer_stop();
+      clock_stopped = TRUE;
+    }
 
   return;
 }
+
+
+/**
+
+   Function: u32_t clock_next(void)
+   --------------------------------
+
+   Return ticks until next needed interrupt: nearest of running thread quantum end
+   and IPC deadline. 0 if none is needed (idle).
+
+**/
+
+PRIVATE u32_t clock_next(void)
+{
+  u32_t quantum,timeout;
+  s32_t left;
+
+  quantum = sched_quantum(cur_th);
+  if (quantum)
+    {
+      /* Quantum left, minus ticks not charged yet */
+      left = (s32_t)(clock_charged + quantum - clock_ticks);
+      quantum = (left > 0 ? (u32_t)left : 1);
+    }
+
+  timeout = syscall_next_timeout(clock_ticks);
+
+  if ( (!quantum) || ((timeout) && (timeout < quantum)) )
+    {
+      return timeout;
+    }
+
+  return quantum;
+}
@@ -32,12 +32,14 @@
    Prototypes
    ----------
 
-   Give access to clock initilization
+   Give access to clock initilization, ticks and timer reprogramming
 
 **/
 
 
 PUBLIC u8_t clock_setup(void);
+PUBLIC u32_t clock_get_ticks(void);
+PUBLIC void clock_reprogram(void);
 
 
 #endif
@@ -17,7 +17,7 @@
    - define.h
    - types.h
    - arch_io.h   : architecture dependent io library
-   - arch_hw.h   : architecture dependent sti
+   - arch_hw.h   : architecture dependent sti and hlt
    - boot.h      : structure boot_info
 
 **/
@@ -132,6 +132,13 @@ PUBLIC int main(void)
       goto err;
     }
 
+  /* ptest1 is the receiver (server): latency sensitive, above senders */
+  if (sched_priority(thtest1,SCHED_PRIO_SERVER) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to set thtest1 priority\n");
+      goto err;
+    }
+
  
   struct proc* ptest2;
   struct thread* thtest2;
@@ -195,6 +202,70 @@ PUBLIC int main(void)
     }
 
 
+  /* ptest4 runs IPC self-checks */
+  struct proc* ptest4;
+  struct thread* thtest4;
+
+  ptest4 = proc_create("ptest4");
+  if (ptest4 == NULL)
+    {
+      arch_printf("Unable to create ptest4\n");
+      goto err;
+    }
+
+  if (proc_memcopy(ptest4,mods[2].start,0x80000000,mods[2].end-mods[2].start) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to copy in ptest4\n");
+      goto err;
+    }
+
+
+  thtest4 = thread_create("thtest4",0x80000000,0x90000000,0x1000);
+  if (thtest4 == NULL)
+    {
+      arch_printf("Unable to create in thtest4\n");
+      goto err;
+    }
+
+  if (proc_add_thread(ptest4,thtest4) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to add thtest4 to ptest4\n");
+      goto err;
+    }
+
+
+  /* ptest5 is IPC self-checks peer */
+  struct proc* ptest5;
+  struct thread* thtest5;
+
+  ptest5 = proc_create("ptest5");
+  if (ptest5 == NULL)
+    {
+      arch_printf("Unable to create ptest5\n");
+      goto err;
+    }
+
+  if (proc_memcopy(ptest5,mods[3].start,0x80000000,mods[3].end-mods[3].start) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to copy in ptest5\n");
+      goto err;
+    }
+
+
+  thtest5 = thread_create("thtest5",0x80000000,0x90000000,0x1000);
+  if (thtest5 == NULL)
+    {
+      arch_printf("Unable to create in thtest5\n");
+      goto err;
+    }
+
+  if (proc_add_thread(ptest5,thtest5) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to add thtest5 to ptest5\n");
+      goto err;
+    }
+
+
   if (irq_setup() != EXIT_SUCCESS)
     {
       arch_printf("Unable to intialize IRQ subsystem\n");
@@ -207,13 +278,19 @@ PUBLIC int main(void)
       goto err;
     }
 
+  /* Kernel setup flow becomes the idle thread */
+  if (sched_set_idle(cur_th) != EXIT_SUCCESS)
+    {
+      arch_printf("Unable to set idle thread\n");
+      goto err;
+    }
+
  err:
-  
+
+  /* Idle loop: wait for interrupts */
   while(1)
     {
-      for(i=0;i<4321;i++)
-	{}
-
+      arch_hlt();
     }
 
   return EXIT_SUCCESS;
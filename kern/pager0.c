@@ -17,7 +17,9 @@
    - define.h
    - types.h
    - arch_const.h : Page size needed
+   - arch_vm.h    : user mapping and kernel alias
    - boot.h       : memory map needed
+   - vm_pool.h    : kernel alias virtual pages
    - pager0.h     : self header
    
 **/
@@ -26,7 +28,9 @@
 #include <define.h>
 #include <types.h>
 #include <arch_const.h>
+#include <arch_vm.h>
 #include "boot.h"
+#include "vm_pool.h"
 #include "pager0.h"
 
 #include <arch_io.h>
@@ -59,6 +63,19 @@
 u8_t* bitmap;
 
 
+/**
+
+   Global: refcount
+   ----------------
+
+   Number of references to each used physical page (mappings sharing it).
+   Pages used at boot are not counted (0).
+
+**/
+
+u8_t* refcount;
+
+
 
 /** 
 
@@ -71,8 +88,6 @@ u8_t* bitmap;
 
 PRIVATE s8_t pager0_getState(u32_t i);
 PRIVATE u8_t pager0_setState(u32_t i, u8_t state);
-PRIVATE physaddr_t pager0_alloc(void)__attribute__((unused));
-PRIVATE u8_t pager0_free(physaddr_t paddr)__attribute__((unused)); 
 
 
 /**
@@ -96,6 +111,10 @@ u8_t pager0_setup(void)
     
   /* Set bitmap */
   bitmap = (u8_t*)(boot.bitmap);
+
+  /* Set reference counts */
+  refcount = (u8_t*)(boot.refcount);
+  arch_memset(0,boot.refcount,(boot.bitmap_size+1) << 3);
   
   /* Run through memory map to fill bitmap */
   mmap = (struct boot_mmap_entry*)boot.mmap_addr;
@@ -181,12 +200,13 @@ PRIVATE u8_t pager0_setState(u32_t i, u8_t state)
 
    Allocate a physical page from bitmap
    
-   Simply run through bitmap and return first page available
+   Simply run through bitmap and return first page available.
+   Return PAGER0_ERROR if no page is available.
 
 **/
 
 
-PRIVATE physaddr_t pager0_alloc(void)
+PUBLIC physaddr_t pager0_alloc(void)
 {
   u32_t p;
 
@@ -198,6 +218,7 @@ PRIVATE physaddr_t pager0_alloc(void)
 	  /* Try to mark it as USED */
 	  if ( pager0_setState(p,USED) == EXIT_SUCCESS )
 	    {
+	      refcount[p] = 1;
 	      return p << ARCH_CONST_PAGE_SHIFT;
 	    }
 	  else
@@ -209,6 +230,36 @@ PRIVATE physaddr_t pager0_alloc(void)
     }
 
   /* Not able to find a free page */
+  return PAGER0_ERROR;
+}
+
+
+/**
+
+   Function: u8_t pager0_ref(physaddr_t paddr)
+   -------------------------------------------
+
+   Take one more reference to used page `paddr`, which is now shared:
+   it is only released once every reference is dropped by `pager0_free`.
+
+**/
+
+
+PUBLIC u8_t pager0_ref(physaddr_t paddr)
+{
+  u32_t p;
+
+  p = paddr >> ARCH_CONST_PAGE_SHIFT;
+  if ( (pager0_getState(p) == USED) && (refcount[p] < 0xFF) )
+    {
+      /* Boot pages are not counted */
+      if (refcount[p])
+	{
+	  refcount[p]++;
+	}
+      return EXIT_SUCCESS;
+    }
+
   return EXIT_FAILURE;
 }
 
@@ -218,19 +269,146 @@ PRIVATE physaddr_t pager0_alloc(void)
    Function: u8_t pager0_free(physaddr_t paddr)
    --------------------------------------------
 
-   Release a physical page into bitmap
+   Drop a reference to a physical page
    
-   Just set page state in bitmap accordingly
+   Page state is set free in bitmap once its last reference is dropped
 
 **/
 
 
-PRIVATE u8_t pager0_free(physaddr_t paddr)
+PUBLIC u8_t pager0_free(physaddr_t paddr)
 {
-  if ( pager0_getState(paddr >> ARCH_CONST_PAGE_SHIFT) == USED )
+  u32_t p;
+
+  p = paddr >> ARCH_CONST_PAGE_SHIFT;
+  if ( pager0_getState(p) == USED )
     {
-      return pager0_setState(paddr >> ARCH_CONST_PAGE_SHIFT,FREE);
+      if (refcount[p] > 1)
+	{
+	  refcount[p]--;
+	  return EXIT_SUCCESS;
+	}
+
+      refcount[p] = 0;
+      return pager0_setState(p,FREE);
     }
 
   return EXIT_FAILURE;
 }
+
+
+
+/**
+
+   Function: u8_t pager0_user_map(virtaddr_t vaddr, physaddr_t paddr)
+   -------------------------------------------------------------------
+
+   Map physical page `paddr` at user page `vaddr` in current address space,
+   without any page fault. 
+
+   A missing page table is backed by a freshly allocated page. 
+   Fail if `vaddr` is already mapped.
+
+**/
+
+
+PUBLIC u8_t pager0_user_map(virtaddr_t vaddr, physaddr_t paddr)
+{
+  physaddr_t table;
+
+  /* Never replace an existing mapping */
+  if (arch_tophys(vaddr))
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (arch_user_map(vaddr,paddr) == EXIT_SUCCESS)
+    {
+      return EXIT_SUCCESS;
+    }
+
+  /* Page table is missing */
+  table = pager0_alloc();
+  if (table == PAGER0_ERROR)
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (arch_user_table(vaddr,table) != EXIT_SUCCESS)
+    {
+      pager0_free(table);
+      return EXIT_FAILURE;
+    }
+
+  return arch_user_map(vaddr,paddr);
+}
+
+
+
+/**
+
+   Function: virtaddr_t pager0_alias(physaddr_t paddr)
+   ---------------------------------------------------
+
+   Map physical page `paddr` at a kernel pool page and return its address,
+   so `paddr` can be reached whatever the current address space is.
+   Return PAGER0_ERROR on failure.
+
+   A pool page may still be backed from a previous use: its physical page 
+   is released first (identity mapped boot pages are not ours to release).
+
+**/
+
+
+PUBLIC virtaddr_t pager0_alias(physaddr_t paddr)
+{
+  virtaddr_t vaddr;
+  physaddr_t old;
+
+  vaddr = vm_pool_alloc();
+  if (vaddr == VM_POOL_ERROR)
+    {
+      return PAGER0_ERROR;
+    }
+
+  old = arch_tophys(vaddr);
+  if (old)
+    {
+      arch_unmap(vaddr);
+      if (old != vaddr)
+	{
+	  pager0_free(old);
+	}
+    }
+
+  if (arch_map(vaddr,paddr) != EXIT_SUCCESS)
+    {
+      vm_pool_free(vaddr);
+      return PAGER0_ERROR;
+    }
+
+  return vaddr;
+}
+
+
+
+/**
+
+   Function: u8_t pager0_unalias(virtaddr_t vaddr)
+   -----------------------------------------------
+
+   Remove kernel alias `vaddr` and return it to pool.
+   The aliased physical page is left to its owner.
+
+**/
+
+
+PUBLIC u8_t pager0_unalias(virtaddr_t vaddr)
+{
+  if (arch_unmap(vaddr) != EXIT_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
+
+  return vm_pool_free(vaddr);
+}
@@ -26,16 +26,36 @@
 #include <types.h>
 
 
+/**
+
+   Constant: PAGER0_ERROR
+   ----------------------
+
+   Error value returned in case of allocation failure
+   It is a non-aligned value
+
+**/
+
+#define PAGER0_ERROR     1
+
+
 /**
 
    Prototypes
    ----------
 
-   Give access to setup
+   Give access to setup, physical pages allocation, 
+   explicit user pages mapping and kernel aliases
 
 **/
 
 u8_t pager0_setup(void);
+PUBLIC physaddr_t pager0_alloc(void);
+PUBLIC u8_t pager0_ref(physaddr_t paddr);
+PUBLIC u8_t pager0_free(physaddr_t paddr);
+PUBLIC u8_t pager0_user_map(virtaddr_t vaddr, physaddr_t paddr);
+PUBLIC virtaddr_t pager0_alias(physaddr_t paddr);
+PUBLIC u8_t pager0_unalias(virtaddr_t vaddr);
 
 
 
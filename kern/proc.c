@@ -18,8 +18,10 @@
    - types.h
    - llist.h
    - arch_io.h       : memcopy
+   - arch_const.h    : page size and kernel boundaries
    - arch_vm.h       : architecture dependant virtual memory
    - vm_slab.h       : slab allocator needed
+   - pager0.h        : explicit user pages mapping
    - thread.h        : struct thread needed
    - proc.h          : self header
 
@@ -30,9 +32,11 @@
 #include <types.h>
 #include <llist.h>
 #include <arch_io.h>
+#include <arch_const.h>
 #include <arch_vm.h>
 #include "vm_pool.h"
 #include "vm_slab.h"
+#include "pager0.h"
 #include "thread.h"
 #include "proc.h"
 
@@ -87,7 +91,7 @@ struct proc* proc_table[PROC_TABLELEN];
    Global: pid_seed
    ----------------
 
-   Global counter for pids
+   Next pid to try, wrapping in [1,PROC_PIDS[
 
 **/
 
@@ -123,6 +127,45 @@ struct vm_cache* proc_cache;
 struct vm_cache* thread_wrapper_cache;
 
 
+/**
+
+   Global: mailbox_cache
+   ---------------------
+
+   Cache for `struct proc_mailbox` allocation
+
+**/
+
+
+struct vm_cache* mailbox_cache;
+
+
+/**
+
+   Global: endpoint_cache
+   ----------------------
+
+   Cache for `struct proc_endpoint` allocation
+
+**/
+
+
+struct vm_cache* endpoint_cache;
+
+
+/**
+
+   Global: proc_groups
+   -------------------
+
+   Process groups
+
+**/
+
+
+struct proc_group proc_groups[PROC_GROUPS];
+
+
 /**
 
    Global: ksetup_proc
@@ -136,6 +179,21 @@ struct thread ksetup_proc;
 
 
 
+/**
+
+   Privates
+   --------
+
+   Endpoint reference and user pages release
+
+**/
+
+
+PRIVATE void proc_endpoint_release(struct proc_endpoint* endpoint);
+PRIVATE u8_t proc_release(struct proc* proc);
+
+
+
 /**
    
    Function:  u8_t proc_setup(void)
@@ -162,6 +220,12 @@ PUBLIC u8_t proc_setup(void)
   /* Initialize `pid_seed` */
   pid_seed = 1;
 
+  /* Empty groups */
+  for(i=0;i<PROC_GROUPS;i++)
+    {
+      proc_groups[i].count = 0;
+    }
+
 
   /* Create cache for `struct proc` allocation */
   proc_cache = vm_cache_create("Proc_Cache",sizeof(struct proc));
@@ -177,9 +241,29 @@ PUBLIC u8_t proc_setup(void)
       goto err0;
     }
 
+  /* Create cache for `struct proc_mailbox` allocation */
+  mailbox_cache = vm_cache_create("Mailbox_Cache",sizeof(struct proc_mailbox));
+  if (mailbox_cache == NULL)
+    {
+      goto err1;
+    }
+
+  /* Create cache for `struct proc_endpoint` allocation */
+  endpoint_cache = vm_cache_create("Endpoint_Cache",sizeof(struct proc_endpoint));
+  if (endpoint_cache == NULL)
+    {
+      goto err2;
+    }
+
 
   return EXIT_SUCCESS;
 
+ err2:
+  vm_cache_destroy(mailbox_cache);
+
+ err1:
+  vm_cache_destroy(thread_wrapper_cache);
+
  err0:
   vm_cache_destroy(proc_cache);
 
@@ -196,6 +280,7 @@ PUBLIC u8_t proc_setup(void)
    Create a process named `name`.
  
    create a synchronized adress space.
+   Its pid is the first free one from `pid_seed`, below PROC_PIDS.
    Return the brand new process or NULL if it fails.
 
 **/
@@ -205,8 +290,25 @@ PUBLIC struct proc* proc_create(char* name)
 {
   struct proc* proc=NULL;
   virtaddr_t asp;
+  pid_t pid;
   u16_t i;
 
+  /* Get a free pid */
+  pid = 0;
+  for(i=1;(i<PROC_PIDS)&&(!pid);i++)
+    {
+      if (proc_pid(pid_seed) == NULL)
+	{
+	  pid = pid_seed;
+	}
+      pid_seed = (pid_seed < PROC_PIDS-1 ? pid_seed+1 : 1);
+    }
+
+  if (!pid)
+    {
+      return NULL;
+    }
+
   /* Allocate a process */
   proc = (struct proc*)vm_cache_alloc(proc_cache);
   if (proc == NULL)
@@ -240,15 +342,52 @@ PUBLIC struct proc* proc_create(char* name)
   /* Threads list initialization */
   LLIST_NULLIFY(proc->thread_list);
 
+  /* IPC queues and notifications initialization */
+  for(i=0;i<PROC_NOTIFY_WORDS;i++)
+    {
+      proc->notify_pending[i] = 0;
+    }
+  for(i=0;i<PROC_PIDS;i++)
+    {
+      proc->notify_skip[i] = 0;
+    }
+  proc->mailbox = NULL;
+  proc->utcb_seed = 0;
+  proc->window = 0;
+  proc->window_pages = 0;
+  LLIST_NULLIFY(proc->wait_list);
+  LLIST_NULLIFY(proc->recv_any);
+  LLIST_NULLIFY(proc->recv_set);
+  for(i=0;i<PROC_IPC_HASHLEN;i++)
+    {
+      LLIST_NULLIFY(proc->recv_from[i]);
+      LLIST_NULLIFY(proc->wait_from[i]);
+    }
+
+  /* No group */
+  proc->groups = 0;
+
+  /* Endpoint object and handles initialization */
+  for(i=0;i<PROC_HANDLES_LEN;i++)
+    {
+      proc->handles[i] = NULL;
+    }
+  proc->endpoint = (struct proc_endpoint*)vm_cache_alloc(endpoint_cache);
+  if (proc->endpoint == NULL)
+    {
+      goto err1;
+    }
+  proc->endpoint->proc = proc;
+  proc->endpoint->refs = 1;
 
   /* Sync address space with kernel */
   if (arch_sync_addrspace(proc->addrspace) != EXIT_SUCCESS)
     {
-      goto err1;
+      goto err2;
     }
 
   /* Set pid */
-  proc->pid = pid_seed++;
+  proc->pid = pid;
 
   /* Store `proc` in proc table */
   LLIST_ADD(proc_table[PROC_HASHID(proc->pid)],proc);
@@ -256,6 +395,10 @@ PUBLIC struct proc* proc_create(char* name)
   
   return proc;
 
+ err2:
+
+  vm_cache_free(endpoint_cache,proc->endpoint);
+
  err1:
 
   vm_pool_free(asp);
@@ -276,7 +419,8 @@ PUBLIC struct proc* proc_create(char* name)
 
    Destroy `proc`
 
-   Destroy all of its threads, the address space and the return `proc` to cache
+   Destroy all of its threads, release its user pages and address space,
+   then return `proc` to cache
 
 **/
 
@@ -284,6 +428,8 @@ PUBLIC struct proc* proc_create(char* name)
 PUBLIC u8_t proc_destroy(struct proc* proc)
 {
   struct thread_wrapper* wrapper;
+  struct proc* p;
+  u32_t i;
 
   /* Sanity check */
   if (proc == NULL)
@@ -310,7 +456,48 @@ PUBLIC u8_t proc_destroy(struct proc* proc)
 	  	  
     }
 
-  /* Free address space */
+  /* Free mailbox */
+  if (proc->mailbox != NULL)
+    {
+      vm_cache_free(mailbox_cache,proc->mailbox);
+    }
+
+  /* Release handles */
+  for(i=0;i<PROC_HANDLES_LEN;i++)
+    {
+      proc_handle_close(proc,i);
+    }
+
+  /* Leave groups */
+  for(i=0;i<PROC_GROUPS;i++)
+    {
+      proc_group_leave(proc,i);
+    }
+
+  /* Pid will be reused: drop notifications from `proc` left in others */
+  for(i=0;i<PROC_TABLELEN;i++)
+    {
+      if (!LLIST_ISNULL(proc_table[i]))
+	{
+	  p = LLIST_GETHEAD(proc_table[i]);
+	  do
+	    {
+	      p->notify_pending[proc->pid>>5] &= ~(1<<(proc->pid&0x1F));
+	      p->notify_skip[proc->pid] = 0;
+	      p = LLIST_NEXT(proc_table[i],p);
+	    }while(!LLIST_ISHEAD(proc_table[i],p));
+	}
+    }
+
+  /* Orphan endpoint, handles to it are now stale */
+  proc->endpoint->proc = NULL;
+  proc_endpoint_release(proc->endpoint);
+
+  /* Release user pages (shared ones drop a reference), then address space */
+  if (proc_release(proc) != EXIT_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
   vm_pool_free(proc->addrspace);
 
   /* Remove from proc table */
@@ -404,6 +591,47 @@ PUBLIC u8_t proc_remove_thread(struct proc* proc, struct thread* th)
 
 
 
+/**
+
+   Function: u8_t proc_mailbox(struct proc* proc)
+   ----------------------------------------------
+
+   Give an empty asynchronous mailbox to `proc`.
+   Succeed if `proc` already has one.
+
+**/
+
+
+PUBLIC u8_t proc_mailbox(struct proc* proc)
+{
+  struct proc_mailbox* mailbox;
+
+  if (proc == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (proc->mailbox != NULL)
+    {
+      return EXIT_SUCCESS;
+    }
+
+  /* Allocate mailbox */
+  mailbox = (struct proc_mailbox*)vm_cache_alloc(mailbox_cache);
+  if (mailbox == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  mailbox->head = 0;
+  mailbox->count = 0;
+  proc->mailbox = mailbox;
+
+  return EXIT_SUCCESS;
+}
+
+
+
 /**
 
    Function: u8_t proc_memcopy(struct proc* proc, virtaddr_t src, virtaddr_t dest, size_t len)
@@ -454,6 +682,342 @@ PUBLIC u8_t proc_memcopy(struct proc* proc, virtaddr_t src, virtaddr_t dest, siz
 
 
 
+/**
+
+   Function: u8_t proc_map(struct proc* proc, virtaddr_t src, virtaddr_t dest, u32_t npages, u8_t grant)
+   -----------------------------------------------------------------------------------------------------
+
+   Map `npages` user pages at `src` in current address space to `proc` address space at `dest`.
+   No data is copied: `proc` pages point to the same physical pages.
+   If `grant` is TRUE, pages are unmapped from current address space (ownership moves).
+   Otherwise pages are shared and get one more reference in pager0, so they live 
+   until both address spaces release them.
+
+   Source pages must be backed and destination pages must be free. Neither is touched:
+   missing page tables are backed explicitly and nothing is left mapped on failure. 
+   Physical addresses are collected by batches of PROC_MAP_BATCH, so address space 
+   is switched twice per batch only.
+
+**/
+
+
+PUBLIC u8_t proc_map(struct proc* proc, virtaddr_t src, virtaddr_t dest, u32_t npages, u8_t grant)
+{
+  virtaddr_t cur_addrspace;
+  physaddr_t paddr[PROC_MAP_BATCH];
+  u32_t i,j,n,done;
+
+  /* Sanity checks */
+  if ( (proc == NULL) || (npages == 0) || (npages > PROC_MAP_MAX)
+       || (src & (ARCH_CONST_PAGE_SIZE-1)) || (dest & (ARCH_CONST_PAGE_SIZE-1))
+       || (src < ARCH_CONST_KERN_HIGHMEM) || (dest < ARCH_CONST_KERN_HIGHMEM)
+       || (src + npages*ARCH_CONST_PAGE_SIZE - 1 < src)
+       || (dest + npages*ARCH_CONST_PAGE_SIZE - 1 < dest) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  cur_addrspace = arch_get_addrspace();
+  if (proc->addrspace == cur_addrspace)
+    {
+      return EXIT_FAILURE;
+    }
+
+  done = 0;
+  for(i=0;i<npages;i+=n)
+    {
+      n = ( (npages-i > PROC_MAP_BATCH) ? PROC_MAP_BATCH : npages-i );
+
+      /* Collect physical pages */
+      for(j=0;j<n;j++)
+	{
+	  paddr[j] = arch_tophys(src+(i+j)*ARCH_CONST_PAGE_SIZE);
+	  if (!paddr[j])
+	    {
+	      goto err;
+	    }
+	}
+
+      /* Map them in `proc` */
+      if (arch_switch_addrspace(proc->addrspace) != EXIT_SUCCESS)
+	{
+	  goto err;
+	}
+
+      for(j=0;j<n;j++)
+	{
+	  if (pager0_user_map(dest+(i+j)*ARCH_CONST_PAGE_SIZE,paddr[j]) != EXIT_SUCCESS)
+	    {
+	      arch_switch_addrspace(cur_addrspace);
+	      goto err;
+	    }
+
+	  /* Shared page: one more reference (a grant moves the existing one) */
+	  if (!grant)
+	    {
+	      pager0_ref(paddr[j]);
+	    }
+	  done++;
+	}
+
+      if (arch_switch_addrspace(cur_addrspace) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
+  /* Grant: source loses the pages */
+  if (grant)
+    {
+      for(i=0;i<npages;i++)
+	{
+	  arch_user_unmap(src+i*ARCH_CONST_PAGE_SIZE);
+	}
+    }
+
+  return EXIT_SUCCESS;
+
+ err:
+  /* Roll back pages already mapped in `proc` */
+  if ( (done) && (arch_switch_addrspace(proc->addrspace) == EXIT_SUCCESS) )
+    {
+      for(i=0;i<done;i++)
+	{
+	  if (!grant)
+	    {
+	      pager0_free(arch_tophys(dest+i*ARCH_CONST_PAGE_SIZE));
+	    }
+	  arch_user_unmap(dest+i*ARCH_CONST_PAGE_SIZE);
+	}
+      arch_switch_addrspace(cur_addrspace);
+    }
+
+  return EXIT_FAILURE;
+}
+
+
+
+/**
+
+   Function: u8_t proc_handle_open(struct proc* proc, struct proc* target, u32_t* handle)
+   --------------------------------------------------------------------------------------
+
+   Give `proc` a handle on `target` endpoint, stored in `handle`.
+   An existing handle on the same endpoint is returned rather than a new one.
+
+**/
+
+
+PUBLIC u8_t proc_handle_open(struct proc* proc, struct proc* target, u32_t* handle)
+{
+  u32_t i,free;
+
+  if ( (proc == NULL) || (target == NULL) || (handle == NULL) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  free = PROC_HANDLES_LEN;
+  for(i=0;i<PROC_HANDLES_LEN;i++)
+    {
+      if (proc->handles[i] == target->endpoint)
+	{
+	  *handle = i;
+	  return EXIT_SUCCESS;
+	}
+
+      if ( (proc->handles[i] == NULL) && (free == PROC_HANDLES_LEN) )
+	{
+	  free = i;
+	}
+    }
+
+  /* Table is full */
+  if (free == PROC_HANDLES_LEN)
+    {
+      return EXIT_FAILURE;
+    }
+
+  proc->handles[free] = target->endpoint;
+  target->endpoint->refs++;
+  *handle = free;
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t proc_handle_close(struct proc* proc, u32_t handle)
+   -----------------------------------------------------------------
+
+   Release `proc` handle `handle`, which can be stale.
+
+**/
+
+
+PUBLIC u8_t proc_handle_close(struct proc* proc, u32_t handle)
+{
+  if ( (proc == NULL) || (handle >= PROC_HANDLES_LEN) || (proc->handles[handle] == NULL) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  proc_endpoint_release(proc->handles[handle]);
+  proc->handles[handle] = NULL;
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: struct proc* proc_handle(struct proc* proc, u32_t handle)
+   -------------------------------------------------------------------
+
+   Return proc structure `proc` handle `handle` refers to.
+
+   A single table index, whatever the number of processes.
+   Return NULL if the handle is invalid or stale (process destroyed).
+
+**/
+
+
+PUBLIC struct proc* proc_handle(struct proc* proc, u32_t handle)
+{
+  if ( (handle >= PROC_HANDLES_LEN) || (proc->handles[handle] == NULL) )
+    {
+      return NULL;
+    }
+
+  return proc->handles[handle]->proc;
+}
+
+
+
+/**
+
+   Function: u8_t proc_group_join(struct proc* proc, u32_t group)
+   --------------------------------------------------------------
+
+   Add `proc` to group `group`.
+   Succeed if `proc` is already a member.
+
+**/
+
+
+PUBLIC u8_t proc_group_join(struct proc* proc, u32_t group)
+{
+  struct proc_group* g;
+
+  g = proc_group(group);
+  if ( (proc == NULL) || (g == NULL) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (proc->groups & (1<<group))
+    {
+      return EXIT_SUCCESS;
+    }
+
+  if (g->count == PROC_GROUP_LEN)
+    {
+      return EXIT_FAILURE;
+    }
+
+  g->members[g->count++] = proc;
+  proc->groups |= (1<<group);
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t proc_group_leave(struct proc* proc, u32_t group)
+   ---------------------------------------------------------------
+
+   Remove `proc` from group `group`.
+   Last member takes its place, so members stay packed.
+
+**/
+
+
+PUBLIC u8_t proc_group_leave(struct proc* proc, u32_t group)
+{
+  struct proc_group* g;
+  u32_t i;
+
+  g = proc_group(group);
+  if ( (proc == NULL) || (g == NULL) || !(proc->groups & (1<<group)) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  for(i=0;i<g->count;i++)
+    {
+      if (g->members[i] == proc)
+	{
+	  g->members[i] = g->members[--g->count];
+	  break;
+	}
+    }
+
+  proc->groups &= ~(1<<group);
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: struct proc_group* proc_group(u32_t group)
+   ----------------------------------------------------
+
+   Return group `group`, NULL if it does not exist.
+
+**/
+
+
+PUBLIC struct proc_group* proc_group(u32_t group)
+{
+  if (group >= PROC_GROUPS)
+    {
+      return NULL;
+    }
+
+  return &proc_groups[group];
+}
+
+
+
+/**
+
+   Function: void proc_endpoint_release(struct proc_endpoint* endpoint)
+   --------------------------------------------------------------------
+
+   Drop a reference on `endpoint`, and free it on last one.
+
+**/
+
+
+PRIVATE void proc_endpoint_release(struct proc_endpoint* endpoint)
+{
+  if (--endpoint->refs == 0)
+    {
+      vm_cache_free(endpoint_cache,endpoint);
+    }
+
+  return;
+}
+
+
+
 /**
 
    Function: struct proc* proc_pid(pid_t pid)
@@ -497,3 +1061,45 @@ PUBLIC struct proc* proc_pid(pid_t pid)
   return NULL;
 
 }
+
+
+
+/**
+
+   Function: u8_t proc_release(struct proc* proc)
+   ----------------------------------------------
+
+   Release `proc` user pages and page tables, in its address space.
+   Each page drops one reference in pager0: pages shared with another
+   process (maps, channels) are freed by the last one.
+
+**/
+
+
+PRIVATE u8_t proc_release(struct proc* proc)
+{
+  virtaddr_t cur_addrspace;
+
+  /* Change address space if needed */
+  cur_addrspace = arch_get_addrspace();
+  if (proc->addrspace != cur_addrspace)
+    {
+      if (arch_switch_addrspace(proc->addrspace) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
+  arch_user_release(&pager0_free);
+
+  /* Switch back to current address space if needed */
+  if (proc->addrspace != cur_addrspace)
+    {
+      if (arch_switch_addrspace(cur_addrspace) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -30,6 +30,10 @@
 #include "thread.h"
 
 
+/* May be included by thread.h before `struct thread` definition */
+struct thread;
+
+
 /**
  
    Constant: PROC_NAMELEN
@@ -58,25 +62,185 @@ typedef unsigned int pid_t;
 
 
 /**
-   
-   Structure: struct thread_wrapper
-   --------------------------------
+ 
+   Constant: PROC_IPC_HASHLEN
+   --------------------------
+
+   Size of the IPC queues hash tables, indexed by source process id.
+   Must divide 64, so a sources set bit maps to a single bucket.
+
+**/
+
+#define PROC_IPC_HASHLEN            8
+
+
+/**
+
+   Macro: PROC_IPC_HASHID
+   ----------------------
 
-   Wrap a thread into a linked list
-   Members are self explanatory
+   Hash function for IPC queues
 
 **/
 
 
-struct thread_wrapper
+#define PROC_IPC_HASHID(__id)			\
+  ( (__id)%(PROC_IPC_HASHLEN) )
+
+
+/**
+ 
+   Constant: PROC_PIDS
+   -------------------
+
+   Process ids are taken in [1,PROC_PIDS[ and recycled once freed,
+   so that every pid fits in sources sets and notifications bitmaps.
+
+**/
+
+#define PROC_PIDS                   IPC_SET_PIDS
+
+
+/**
+ 
+   Constant: PROC_NOTIFY_WORDS
+   ---------------------------
+
+   Size of the pending notifications bitmap, in 32 bits words.
+   Bit `pid` stands for process `pid`, like in sources sets (pids are below PROC_PIDS).
+   Bitmap is delivered in message registers, so it must fit in 2 words.
+
+**/
+
+#define PROC_NOTIFY_WORDS           IPC_SET_WORDS
+
+
+/**
+ 
+   Constant: PROC_MAILBOX_LEN
+   --------------------------
+
+   Number of messages a process mailbox can hold
+
+**/
+
+#define PROC_MAILBOX_LEN            16
+
+
+/**
+ 
+   Constants: PROC_MAP_MAX, PROC_MAP_BATCH
+   ---------------------------------------
+
+   Maximum number of pages mapped by a single `proc_map`,
+   and number of pages handled per address space switch
+
+**/
+
+#define PROC_MAP_MAX                1024
+#define PROC_MAP_BATCH              32
+
+
+/**
+ 
+   Constant: PROC_HANDLES_LEN
+   --------------------------
+
+   Size of a process endpoint handles table
+
+**/
+
+#define PROC_HANDLES_LEN            32
+
+
+/**
+ 
+   Constants: PROC_GROUPS, PROC_GROUP_LEN
+   --------------------------------------
+
+   Number of process groups and max members per group
+
+**/
+
+#define PROC_GROUPS                 IPC_GROUPS
+#define PROC_GROUP_LEN              32
+
+
+
+/**
+
+   Structure: struct proc_mailbox
+   ------------------------------
+
+   Bounded asynchronous mailbox, as a ring of messages.
+   Members are:
+
+   - head  : oldest message index in `msg`
+   - count : number of messages held
+   - msg   : messages, each as source pid then 3 data words
+
+**/
+
+
+struct proc_mailbox
+{
+  u32_t head;
+  u32_t count;
+  struct 
+  {
+    u32_t from;
+    u32_t data[3];
+  } msg[PROC_MAILBOX_LEN];
+};
+
+
+
+/**
+
+   Structure: struct proc_endpoint
+   -------------------------------
+
+   Kernel endpoint object of a process, referred to by handles.
+   It outlives its process while handles remain, so stale handles
+   are detected without looking up the process. Members are:
+
+   - proc : process messages are delivered to (NULL once destroyed)
+   - refs : references count (process itself plus handles)
+
+**/
+
+
+struct proc_endpoint
 {
-  struct thread* thread;
-  struct thread_wrapper* prev;
-  struct thread_wrapper* next;
+  struct proc* proc;
+  u32_t refs;
 };
 
 
 
+
+/**
+
+   Structure: struct proc_group
+   ----------------------------
+
+   Process group, target of group sends. Members are:
+
+   - count   : number of processes in group
+   - members : processes in group
+
+**/
+
+
+struct proc_group
+{
+  u32_t count;
+  struct proc* members[PROC_GROUP_LEN];
+};
+
+
+
+
 /**
  
    Structure: struct proc 
@@ -89,7 +253,21 @@ struct thread_wrapper
    - addr_space   : address space
    - name         : process name
    - thread_list  : threads in process
-   - wait_list    : threads waiting for receive
+   - wait_list    : threads waiting for receive, in arrival order
+   - wait_from    : same threads, hashed by their process id
+   - recv_any     : threads blocked receiving from ANY
+   - recv_from    : threads blocked receiving from a given process, hashed by its pid
+   - recv_set     : threads blocked receiving from a sources set
+   - notify_pending : pending notifications bitmap, keyed by source pid
+   - notify_skip  : per source pid, number of its messages taken without blocking it
+                    (as many next notifies to it are acknowledgements nobody waits for)
+   - mailbox      : asynchronous mailbox (NULL if synchronous only)
+   - utcb_seed    : UTCB pages allocated in process
+   - window       : receive window base, where pages may be mapped by others
+   - window_pages : receive window size in pages (0 if closed)
+   - endpoint     : process own endpoint object
+   - handles      : endpoint handles table (NULL entries are free)
+   - groups       : groups membership bitmap
    - prev,next    : linkage in proc table
 
 **/
@@ -100,7 +278,20 @@ PUBLIC struct proc
   virtaddr_t addrspace; 
   char name[PROC_NAMELEN];
   struct thread_wrapper* thread_list;
-  struct thread* wait_list;
+  struct thread_wrapper* wait_list;
+  struct thread_wrapper* wait_from[PROC_IPC_HASHLEN];
+  struct thread_wrapper* recv_any;
+  struct thread_wrapper* recv_from[PROC_IPC_HASHLEN];
+  struct thread_wrapper* recv_set;
+  u32_t notify_pending[PROC_NOTIFY_WORDS];
+  u16_t notify_skip[PROC_PIDS];
+  struct proc_mailbox* mailbox;
+  u32_t utcb_seed;
+  virtaddr_t window;
+  u32_t window_pages;
+  struct proc_endpoint* endpoint;
+  struct proc_endpoint* handles[PROC_HANDLES_LEN];
+  u32_t groups;
   struct proc* prev;
   struct proc* next;
 }__attribute__ ((packed));
@@ -113,7 +304,8 @@ PUBLIC struct proc
    ----------
 
    Give access to process initialization, creation, thread addition/removal, 
-   in-memory copy and pid to proc conversion
+   mailbox creation, in-memory copy, pages mapping, endpoint handles management,
+   groups membership and pid (or handle) to proc conversion
 
 **/
 
@@ -122,7 +314,15 @@ PUBLIC struct proc* proc_create(char* name);
 PUBLIC u8_t proc_destroy(struct proc* proc);
 PUBLIC u8_t proc_add_thread(struct proc* proc, struct thread* th);
 PUBLIC u8_t proc_remove_thread(struct proc* proc, struct thread* th);
+PUBLIC u8_t proc_mailbox(struct proc* proc);
+PUBLIC u8_t proc_map(struct proc* proc, virtaddr_t src, virtaddr_t dest, u32_t npages, u8_t grant);
 PUBLIC u8_t proc_memcopy(struct proc* proc, virtaddr_t src, virtaddr_t dest, size_t len);
+PUBLIC u8_t proc_handle_open(struct proc* proc, struct proc* target, u32_t* handle);
+PUBLIC u8_t proc_handle_close(struct proc* proc, u32_t handle);
+PUBLIC struct proc* proc_handle(struct proc* proc, u32_t handle);
+PUBLIC u8_t proc_group_join(struct proc* proc, u32_t group);
+PUBLIC u8_t proc_group_leave(struct proc* proc, u32_t group);
+PUBLIC struct proc_group* proc_group(u32_t group);
 PUBLIC struct proc* proc_pid(pid_t pid);
 
 #endif
@@ -19,6 +19,7 @@
   - const.h
   - thread.h : struct thread needed
   - sched.h  : self header
+  - arch_vm.h: address space switch
 
 **/
 
@@ -30,22 +31,92 @@
 #include "sched.h"
 
 #include <arch_io.h>
+#include <arch_vm.h>
 
 /**
    
    Privates
    --------
 
-   Scheduler queues
+   Scheduler queues. Ready queue is made of one queue per priority, 
+   and a bitmap of non empty ones (bit `n` for priority `n`).
 
 **/
 
-PRIVATE struct thread* sched_ready;
+PRIVATE struct thread* sched_ready[SCHED_PRIO_LEVELS];
+PRIVATE u32_t sched_ready_bitmap;
 PRIVATE struct thread* sched_running;
 PRIVATE struct thread* sched_blocked;
 PRIVATE struct thread* sched_dead;
 
 
+/**
+   
+   Private: sched_idle
+   -------------------
+
+   Idle thread, elected when ready queue is empty. It is kept out of the queues.
+
+**/
+
+PRIVATE struct thread* sched_idle;
+
+
+/**
+   
+   Private: sched_resched
+   ----------------------
+
+   Set when a thread made ready outranks the running one (see `sched_preempt`)
+
+**/
+
+PRIVATE u8_t sched_resched;
+
+
+/**
+   
+   Privates
+   --------
+
+   Priority change helper
+
+**/
+
+PRIVATE void sched_prio(struct thread* th, u8_t prio);
+
+
+/**
+
+   Globals: Switch counters
+   ------------------------
+
+   Involuntary (preemption by clock) and voluntary (IPC blocking) thread switches,
+   clock ticks which did not lead to a reschedule and switches which kept the address space
+
+**/
+
+
+u32_t sched_switches_involuntary;
+u32_t sched_switches_voluntary;
+u32_t sched_ticks_kept;
+u32_t sched_addrspace_kept;
+
+
+/**
+
+   Globals: Tick counters
+   ----------------------
+
+   Clock ticks charged to threads, and those charged to idle thread (CPU utilisation)
+
+**/
+
+
+u32_t sched_ticks;
+u32_t sched_idle_ticks;
+
+
 /**
 
    Function: u8_t sched_setup(void)
@@ -59,7 +130,14 @@ PRIVATE struct thread* sched_dead;
 
 PUBLIC u8_t sched_setup(void)
 {
-  LLIST_NULLIFY(sched_ready);
+  u8_t i;
+
+  for(i=0;i<SCHED_PRIO_LEVELS;i++)
+    {
+      LLIST_NULLIFY(sched_ready[i]);
+    }
+  sched_ready_bitmap = 0;
+  sched_resched = FALSE;
   LLIST_NULLIFY(sched_running);
   LLIST_NULLIFY(sched_blocked);
   LLIST_NULLIFY(sched_dead);
@@ -68,6 +146,35 @@ PUBLIC u8_t sched_setup(void)
 }
 
 
+/**
+
+   Function: u8_t sched_init(struct thread* th)
+   --------------------------------------------
+
+   Set default scheduling parameters of a new thread:
+   default priority, at the top of its staircase with a full quantum.
+
+**/
+
+
+PUBLIC u8_t sched_init(struct thread* th)
+{
+  if (th == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  th->sched.static_prio = SCHED_PRIO_DEFAULT;
+  th->sched.dynamic_prio = SCHED_PRIO_DEFAULT;
+  th->sched.head_prio = SCHED_PRIO_DEFAULT;
+  th->sched.inherit_prio = SCHED_PRIO_LEVELS;
+  th->sched.static_quantum = SCHED_QUANTUM;
+  th->sched.dynamic_quantum = SCHED_QUANTUM;
+
+  return EXIT_SUCCESS;
+}
+
+
 /**
 
    Function: u8_t sched_enqueue(u8_t queue, struct thread* th)
@@ -76,7 +183,7 @@ PUBLIC u8_t sched_setup(void)
    Add a thread to a scheduler queue. There are 4 queues:
 
    - SCHED_RUNNING_QUEUE : Thread is currently being executed by processor
-   - SCHED_READY_QUEUE   : Thread is ready to be executed.
+   - SCHED_READY_QUEUE   : Thread is ready to be executed (queue of its dynamic priority).
    - SCHED_BLOCKED_QUEUE : Thread is blocked in an IPC operation
    - SCHED_DEAD_QUEUE    : Thread is dead, waiting to be deleted
 
@@ -103,7 +210,8 @@ PUBLIC u8_t sched_enqueue(u8_t queue, struct thread* th)
       break;
 
     case SCHED_READY_QUEUE:
-      LLIST_ADD(sched_ready, th);
+      LLIST_ADD(sched_ready[th->sched.dynamic_prio], th);
+      sched_ready_bitmap |= (1<<th->sched.dynamic_prio);
       th->state = THREAD_READY;
       break;
 
@@ -122,6 +230,8 @@ PUBLIC u8_t sched_enqueue(u8_t queue, struct thread* th)
       
     }
 
+    th->sched.queue = queue;
+
     return EXIT_SUCCESS;
 
 }
@@ -152,7 +262,11 @@ PUBLIC u8_t sched_dequeue(u8_t queue, struct thread* th)
       break;
 
     case SCHED_READY_QUEUE:
-      LLIST_REMOVE(sched_ready, th);
+      LLIST_REMOVE(sched_ready[th->sched.dynamic_prio], th);
+      if (LLIST_ISNULL(sched_ready[th->sched.dynamic_prio]))
+	{
+	  sched_ready_bitmap &= ~(1<<th->sched.dynamic_prio);
+	}
       break;
       
     case SCHED_BLOCKED_QUEUE:
@@ -168,6 +282,8 @@ PUBLIC u8_t sched_dequeue(u8_t queue, struct thread* th)
       
     }
 
+  th->sched.queue = 0;
+
   return EXIT_SUCCESS;
 
 }
@@ -175,47 +291,542 @@ PUBLIC u8_t sched_dequeue(u8_t queue, struct thread* th)
 
 /**
 
-   Function: void sched_schedule(u8_t flag)
-   ----------------------------------------
+   Function: u8_t sched_block(struct thread* th)
+   ---------------------------------------------
 
-   Main scheduler fonction. 
+   Block `th` in IPC.
+
+   Lazy scheduling: `th` is only marked blocked and stays in the ready queue.
+   It is moved to the blocked queue by `sched_elect` if still blocked when met, 
+   so a thread blocking briefly (like in a RPC) involves no queue manipulation.
 
 **/
 
 
-PUBLIC struct thread* sched_elect()
+PUBLIC u8_t sched_block(struct thread* th)
 {
-  struct thread* th;
+  if (th == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  th->state = THREAD_BLOCKED;
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_unblock(struct thread* th)
+   -----------------------------------------------
+
+   Make `th`, blocked by `sched_block`, ready again.
+   Queues are only touched if `sched_elect` has moved it to the blocked queue.
+
+   Staircase: a thread waking up has not used its quantum up, so its top step
+   climbs back toward its own priority, and it restarts from there with a full quantum.
+   Threads often blocked in IPC so stay at high priority.
+
+   If `th` outranks the running thread, a reschedule is requested (see `sched_preempt`).
+
+**/
+
+
+PUBLIC u8_t sched_unblock(struct thread* th)
+{
+  if (th == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (th->sched.head_prio > th->sched.static_prio)
+    {
+      th->sched.head_prio--;
+    }
+  th->sched.dynamic_quantum = th->sched.static_quantum;
+
+  /* Do not lose an inherited priority */
+  if (th->sched.dynamic_prio > th->sched.head_prio)
+    {
+      sched_prio(th,th->sched.head_prio);
+    }
+
+  if (th->sched.queue != SCHED_READY_QUEUE)
+    {
+      sched_dequeue(th->sched.queue,th);
+      sched_enqueue(SCHED_READY_QUEUE,th);
+    }
+  else
+    {
+      th->state = THREAD_READY;
+    }
+
+  /* Running thread must give way */
+  if ( (cur_th == NULL) || (cur_th == sched_idle) || (th->sched.dynamic_prio < cur_th->sched.dynamic_prio) )
+    {
+      sched_resched = TRUE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_inherit(struct thread* th, u8_t prio)
+   ----------------------------------------------------------
+
+   Boost `th` up to priority `prio` (priority inheritance).
+   Nothing is done if `th` already runs at a higher priority, 
+   but `prio` is remembered as a floor for the staircase (see `sched_tick`).
+
+**/
+
+
+PUBLIC u8_t sched_inherit(struct thread* th, u8_t prio)
+{
+  if (th == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (prio < th->sched.inherit_prio)
+    {
+      th->sched.inherit_prio = prio;
+    }
+
+  if (prio < th->sched.dynamic_prio)
+    {
+      sched_prio(th,prio);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_disinherit(struct thread* th)
+   --------------------------------------------------
+
+   Drop inherited priority: `th` goes back to the top of its staircase.
+   Nothing is done if `th` is not boosted above it.
+
+**/
+
+
+PUBLIC u8_t sched_disinherit(struct thread* th)
+{
+  if (th == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  th->sched.inherit_prio = SCHED_PRIO_LEVELS;
+
+  if (th->sched.dynamic_prio < th->sched.head_prio)
+    {
+      sched_prio(th,th->sched.head_prio);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_priority(struct thread* th, u8_t prio)
+   -----------------------------------------------------------
+
+   Set `th` own priority to `prio`, restarting its staircase from there. 
+   An inherited higher priority is kept.
+
+**/
+
+
+PUBLIC u8_t sched_priority(struct thread* th, u8_t prio)
+{
+  if ( (th == NULL) || (prio >= SCHED_PRIO_LEVELS) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* Not boosted: effective priority follows */
+  if (th->sched.dynamic_prio >= th->sched.head_prio)
+    {
+      sched_prio(th,prio);
+    }
+  th->sched.static_prio = prio;
+  th->sched.head_prio = prio;
+  th->sched.dynamic_quantum = th->sched.static_quantum;
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_set_idle(struct thread* th)
+   ------------------------------------------------
+
+   Make `th` the idle thread: it leaves the ready queue and will only be 
+   elected when no other thread is ready. Its quantum is never charged.
+
+**/
 
-  //arch_printf("READY: ");
-  if (!LLIST_ISNULL(sched_ready))
+
+PUBLIC u8_t sched_set_idle(struct thread* th)
+{
+  if ( (th == NULL) || (sched_idle != NULL) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (th->sched.queue)
+    {
+      sched_dequeue(th->sched.queue,th);
+    }
+
+  sched_idle = th;
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+
+   Function: u8_t sched_tick(struct thread* th, u32_t ticks)
+   ---------------------------------------------------------
+
+   Account `ticks` clock ticks to running thread `th` (staircase scheduler).
+
+   Once its quantum is used up at a step, `th` steps down to the next lower priority 
+   with a new quantum. Past the lowest priority, it restarts one step below its previous
+   top step. So CPU hogs go down the staircase while threads blocking 
+   before the end of their quantum (see `sched_unblock`) keep their priority.
+   A thread never steps below its inherited priority: it then only gets a new quantum.
+
+   Return TRUE if a reschedule is needed: quantum used up, higher priority thread
+   ready or `th` not runnable anymore. FALSE otherwise, `th` simply goes on.
+
+**/
+
+
+PUBLIC u8_t sched_tick(struct thread* th, u32_t ticks)
+{
+  sched_ticks += ticks;
+
+  if ( (th) && (th == sched_idle) )
+    {
+      sched_idle_ticks += ticks;
+      return TRUE;
+    }
+
+  if (!sched_quantum(th))
+    {
+      return TRUE;
+    }
+
+  if (ticks < (u32_t)th->sched.dynamic_quantum)
     {
-      th = LLIST_GETHEAD(sched_ready);
-      do
+      th->sched.dynamic_quantum -= ticks;
+
+      /* Preempt only for a higher priority thread */
+      if ( (sched_ready_bitmap) && (arch_bsf(sched_ready_bitmap) < th->sched.dynamic_prio) )
 	{
-	  //arch_printf("%u ",th->proc?th->proc->pid:0);
-	  th = LLIST_NEXT(sched_ready,th);
-	}while(!LLIST_ISHEAD(sched_ready,th));
+	  return TRUE;
+	}
+
+      sched_ticks_kept++;
+      return FALSE;
+    }
+
+  th->sched.dynamic_quantum = th->sched.static_quantum;
+
+  if (th->sched.dynamic_prio < SCHED_PRIO_LEVELS-1)
+    {
+      /* Step down, keeping inherited priority */
+      if (th->sched.dynamic_prio < th->sched.inherit_prio)
+	{
+	  sched_prio(th,th->sched.dynamic_prio+1);
+	}
+    }
+  else
+    {
+      /* Bottom reached: restart from a lower top step */
+      if (th->sched.head_prio < SCHED_PRIO_LEVELS-1)
+	{
+	  th->sched.head_prio++;
+	}
+      sched_prio(th,(th->sched.head_prio < th->sched.inherit_prio ? th->sched.head_prio : th->sched.inherit_prio));
+    }
+
+  return TRUE;
+}
+
+
+/**
+
+   Function: u32_t sched_quantum(struct thread* th)
+   ------------------------------------------------
+
+   Return ticks left in `th` quantum, 0 if `th` is not runnable or is idle thread.
+   Used by clock to program next timer interrupt.
+
+**/
+
+
+PUBLIC u32_t sched_quantum(struct thread* th)
+{
+  if ( (th == NULL) || (th->sched.queue != SCHED_READY_QUEUE) || (th->state == THREAD_BLOCKED) )
+    {
+      return 0;
+    }
+
+  return (th->sched.dynamic_quantum > 0 ? th->sched.dynamic_quantum : 1);
+}
+
+
+/**
+
+   Function: void sched_donate(struct thread* from, struct thread* to)
+   -------------------------------------------------------------------
+
+   Timeslice donation on IPC handoff: `to` runs on what is left of `from` quantum,
+   so ticks not charged yet are charged to the donated quantum at next clock interrupt.
+   `from` gets a new quantum once unblocked (see `sched_unblock`).
+
+**/
+
+
+PUBLIC void sched_donate(struct thread* from, struct thread* to)
+{
+  if ( (from == NULL) || (to == NULL) || (from == to) || (from == sched_idle) || (to == sched_idle) )
+    {
+      return;
+    }
+
+  to->sched.dynamic_quantum = (from->sched.dynamic_quantum > 0 ? from->sched.dynamic_quantum : 1);
+
+  return;
+}
+
+
+/**
+
+   Function: u8_t sched_outranked(struct thread* th)
+   -------------------------------------------------
+
+   Return TRUE if a ready thread has a higher priority than `th` 
+   (any ready thread if `th` is NULL, idle or blocked). FALSE otherwise.
+   Blocked heads met on the way are cleaned up as in `sched_elect`.
+
+**/
+
+
+PUBLIC u8_t sched_outranked(struct thread* th)
+{
+  struct thread* head;
+  u32_t prio;
+
+  while(sched_ready_bitmap)
+    {
+      prio = arch_bsf(sched_ready_bitmap);
+      if ( (th != NULL) && (th != sched_idle) && (th->state != THREAD_BLOCKED) 
+	   && (prio >= th->sched.dynamic_prio) )
+	{
+	  return FALSE;
+	}
+
+      /* Lazy cleanup */
+      head = LLIST_GETHEAD(sched_ready[prio]);
+      if (head->state == THREAD_BLOCKED)
+	{
+	  sched_dequeue(SCHED_READY_QUEUE,head);
+	  sched_enqueue(SCHED_BLOCKED_QUEUE,head);
+	  continue;
+	}
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/**
+
+   Function: void sched_preempt(void)
+   ----------------------------------
+
+   Called once scheduling state changed outside clock interrupt (end of syscall).
+   If a thread made ready since outranks the running one, it is elected and
+   switched to right away, instead of waiting for the running thread quantum end.
+
+**/
+
+
+PUBLIC void sched_preempt(void)
+{
+  if (!sched_resched)
+    {
+      return;
+    }
+  sched_resched = FALSE;
+
+  if (sched_outranked(cur_th))
+    {
+      sched_switch(sched_elect(),FALSE);
+    }
+
+  return;
+}
+
+
+/**
+
+   Function: void sched_switch(struct thread* th, u8_t voluntary)
+   --------------------------------------------------------------
+
+   Switch to elected thread `th`, counting the switch as `voluntary` or not.
+   Nothing is done if `th` is already running. 
+   Address space is reloaded only if `th` lives in another one.
+
+**/
+
+
+PUBLIC void sched_switch(struct thread* th, u8_t voluntary)
+{
+  if ( (th == NULL) || (th == cur_th) )
+    {
+      return;
     }
-  //arch_printf("\n");
 
-  //arch_printf("BLOCKED: ");
-  if (!LLIST_ISNULL(sched_blocked))
+  if (voluntary)
     {
-      th = LLIST_GETHEAD(sched_blocked);
-      do
+      sched_switches_voluntary++;
+    }
+  else
+    {
+      sched_switches_involuntary++;
+    }
+
+  /* Change address space */
+  if (th->proc)
+    {
+      if (th->proc->addrspace != arch_get_addrspace())
+	{
+	  arch_switch_addrspace(th->proc->addrspace);
+	}
+      else
 	{
-	  //arch_printf("%u ",th->proc?th->proc->pid:0);
-	  th = LLIST_NEXT(sched_blocked,th);
-	}while(!LLIST_ISHEAD(sched_blocked,th));
+	  sched_addrspace_kept++;
+	}
     }
-  //arch_printf("\n");
 
+  thread_switch_to(th);
 
+  return;
+}
+
+
+/**
+
+   Function: void sched_dump(void)
+   -------------------------------
 
-  th = LLIST_GETHEAD(sched_ready);
-  sched_dequeue(SCHED_READY_QUEUE,th);
-  sched_enqueue(SCHED_READY_QUEUE,th);
+   Print scheduler statistics
+
+**/
+
+
+PUBLIC void sched_dump(void)
+{
+  arch_printf("Sched: %u involuntary %u voluntary switches, %u ticks kept, %u same address space\n",
+	      sched_switches_involuntary,sched_switches_voluntary,sched_ticks_kept,sched_addrspace_kept);
+  arch_printf("Sched: %u idle ticks out of %u\n",sched_idle_ticks,sched_ticks);
+
+  return;
+}
+
+
+/**
+
+   Function: void sched_prio(struct thread* th, u8_t prio)
+   -------------------------------------------------------
+
+   Change `th` dynamic priority, moving it to the matching
+   ready queue if it is in ready queue. State is left untouched.
+
+**/
+
+
+PRIVATE void sched_prio(struct thread* th, u8_t prio)
+{
+  if (th->sched.queue != SCHED_READY_QUEUE)
+    {
+      th->sched.dynamic_prio = prio;
+      return;
+    }
+
+  LLIST_REMOVE(sched_ready[th->sched.dynamic_prio], th);
+  if (LLIST_ISNULL(sched_ready[th->sched.dynamic_prio]))
+    {
+      sched_ready_bitmap &= ~(1<<th->sched.dynamic_prio);
+    }
+
+  th->sched.dynamic_prio = prio;
+
+  LLIST_ADD(sched_ready[prio], th);
+  sched_ready_bitmap |= (1<<prio);
+
+  return;
+}
+
+
+/**
+
+   Function: void sched_schedule(u8_t flag)
+   ----------------------------------------
+
+   Main scheduler fonction. 
+
+   Elect the head of the highest priority non empty ready queue, found by a 
+   bit scan of the ready bitmap, then rotate this queue (round robin among equals).
+   A head found blocked (lazy scheduling) goes to the blocked queue instead.
+   Constant time, apart from lazy cleanups, done once per block.
+   Idle thread is elected if ready queue is empty (NULL if there is no idle thread yet).
+
+**/
+
+
+PUBLIC struct thread* sched_elect()
+{
+  struct thread* th;
+  u32_t prio;
+
+  /* Election serves any pending reschedule */
+  sched_resched = FALSE;
+
+  while(sched_ready_bitmap)
+    {
+      prio = arch_bsf(sched_ready_bitmap);
+      th = LLIST_GETHEAD(sched_ready[prio]);
+
+      /* Lazy cleanup */
+      if (th->state == THREAD_BLOCKED)
+	{
+	  sched_dequeue(SCHED_READY_QUEUE,th);
+	  sched_enqueue(SCHED_BLOCKED_QUEUE,th);
+	  continue;
+	}
+
+      /* Round robin: next one becomes head, `th` the tail */
+      sched_ready[prio] = LLIST_NEXT(sched_ready[prio],th);
+
+      return th;
+    }
 
-  return th;
+  return sched_idle;
 }
@@ -38,19 +38,60 @@
 #define SCHED_DEAD_QUEUE             4
 
 
+/**
+   Constants: Priorities
+   ---------------------
+
+   Lower value means higher priority. 
+   Levels must fit in a 32 bits ready bitmap.
+   Servers run above default (batch) threads, so they preempt them.
+
+**/
+
+#define SCHED_PRIO_LEVELS            32
+#define SCHED_PRIO_SERVER            8
+#define SCHED_PRIO_DEFAULT           16
+
+
+/**
+   Constant: SCHED_QUANTUM
+   -----------------------
+
+   Default quantum, in clock ticks, spent at each staircase step
+
+**/
+
+#define SCHED_QUANTUM                2
+
+
 
 /**
 
    Prototypes
    ----------
 
-   Give access to initialization, queue manipulation ans scheduling itself
+   Give access to initialization, queue manipulation, (lazy) blocking, priority setting
+   and inheritance, idle thread, clock tick accounting, scheduling, preemption, timeslice donation and switching
 
 **/
 
 PUBLIC u8_t sched_setup(void);
+PUBLIC u8_t sched_init(struct thread* th);
 PUBLIC u8_t sched_enqueue(u8_t queue, struct thread* th);
 PUBLIC u8_t sched_dequeue(u8_t queue, struct thread* th);
+PUBLIC u8_t sched_block(struct thread* th);
+PUBLIC u8_t sched_unblock(struct thread* th);
+PUBLIC u8_t sched_priority(struct thread* th, u8_t prio);
+PUBLIC u8_t sched_inherit(struct thread* th, u8_t prio);
+PUBLIC u8_t sched_disinherit(struct thread* th);
+PUBLIC u8_t sched_set_idle(struct thread* th);
+PUBLIC u8_t sched_tick(struct thread* th, u32_t ticks);
+PUBLIC u32_t sched_quantum(struct thread* th);
+PUBLIC u8_t sched_outranked(struct thread* th);
+PUBLIC void sched_preempt(void);
+PUBLIC void sched_donate(struct thread* from, struct thread* to);
+PUBLIC void sched_switch(struct thread* th, u8_t voluntary);
+PUBLIC void sched_dump(void);
 PUBLIC struct thread* sched_elect();
 
 #endif
@@ -24,6 +24,8 @@
    - proc.h          : proc needed
    - thread.h        : struct thread needed
    - sched.h         : scheduler queue manipulation
+   - clock.h         : ticks for timeouts
+   - pager0.h        : channel ring pages
    - syscall.h       : self header
 
 
@@ -38,6 +40,8 @@
 #include "proc.h"
 #include "thread.h"
 #include "sched.h"
+#include "clock.h"
+#include "pager0.h"
 #include "syscall.h"
 
 
@@ -55,6 +59,35 @@
 #define SYSCALL_SEND        1
 #define SYSCALL_RECEIVE     2
 #define SYSCALL_NOTIFY      3
+#define SYSCALL_SENDREC     4
+#define SYSCALL_REPLY_RECEIVE  5
+#define SYSCALL_MAILBOX     6
+#define SYSCALL_UTCB        7
+#define SYSCALL_MAP         8
+#define SYSCALL_SEND_TIMEOUT    9
+#define SYSCALL_RECEIVE_TIMEOUT 10
+#define SYSCALL_RECEIVE_SET 11
+#define SYSCALL_HANDLE      12
+#define SYSCALL_HANDLE_CLOSE 13
+#define SYSCALL_SEND_BATCH  14
+#define SYSCALL_CHANNEL     15
+#define SYSCALL_GROUP       16
+#define SYSCALL_GROUP_SEND  17
+#define SYSCALL_WINDOW      18
+
+
+/**
+
+   Constants: Syscall number register layout
+   -----------------------------------------
+
+   Timed syscalls carry their timeout in the upper bits of the syscall number register
+
+**/
+
+
+#define SYSCALL_NUM_MASK       0xFF
+#define SYSCALL_TIMEOUT_SHIFT  8
 
 
 /**
@@ -68,6 +101,139 @@
 #define SYSCALL_IPC_SENDING    1
 #define SYSCALL_IPC_RECEIVING  2
 #define SYSCALL_IPC_NOTIFYING  3
+#define SYSCALL_IPC_SENDREC    4
+#define SYSCALL_IPC_TIMED      8
+#define SYSCALL_IPC_SET        16
+
+
+/**
+
+   Macros: SYSCALL_NOTIFY_WORD, SYSCALL_NOTIFY_BIT
+   -----------------------------------------------
+
+   Locate process `__pid` in a pending notifications bitmap
+
+**/
+
+
+#define SYSCALL_NOTIFY_WORD(__pid)		\
+  ( (__pid)>>5 )
+
+#define SYSCALL_NOTIFY_BIT(__pid)		\
+  ( 1<<((__pid)&0x1F) )
+
+
+/**
+
+   Macro: SYSCALL_NOTIFY_SKIP
+   --------------------------
+
+   Record in `__proc` that a message from `__pid` was taken without blocking its sender:
+   the notify which usually ends a send would be spurious, it is dropped (see `syscall_notify`).
+   Skips are counted per source, so each message taken drops exactly one notify.
+
+**/
+
+
+#define SYSCALL_NOTIFY_SKIP(__proc,__pid)				\
+  ( (__proc)->notify_skip[(__pid)]++ )
+
+
+/**
+
+   Constant: SYSCALL_HANDOFF
+   -------------------------
+
+   When TRUE, a thread blocking in IPC switches directly to the thread 
+   it has just unblocked (if any), giving it the remaining time slice.
+   When FALSE, the scheduler always elects the next thread.
+
+**/
+
+
+#define SYSCALL_HANDOFF        TRUE
+
+
+/**
+
+   Constant: SYSCALL_DEADLOCK_DEPTH
+   --------------------------------
+
+   Maximum number of hops followed along the send chain by deadlock detection
+
+**/
+
+
+#define SYSCALL_DEADLOCK_DEPTH  16
+
+
+/**
+
+   Globals: Fast path counters
+   ---------------------------
+
+   Syscalls handled (or not) by `syscall_fastpath`
+
+**/
+
+
+u32_t syscall_fast_hits;
+u32_t syscall_fast_misses;
+
+
+/**
+
+   Constant: SYSCALL_RTT_ROUNDS
+   ----------------------------
+
+   Number of sendrec round trips averaged in `syscall_rtt_cycles`
+
+**/
+
+
+#define SYSCALL_RTT_ROUNDS  1000
+
+
+/**
+
+   Globals: Round trip measure
+   ---------------------------
+
+   Average CPU cycles from sendrec to reply delivery over the last SYSCALL_RTT_ROUNDS 
+   round trips (0 until enough are done), and the running sum and count of the current rounds
+
+**/
+
+
+u32_t syscall_rtt_cycles;
+u32_t syscall_rtt_sum;
+u32_t syscall_rtt_count;
+
+
+/**
+
+   Global: syscall_deadlocks
+   -------------------------
+
+   Deadlocks detected (and refused) by `syscall_deadlock`
+
+**/
+
+
+u32_t syscall_deadlocks;
+
+
+/**
+
+   Global: syscall_timeouts
+   ------------------------
+
+   Threads blocked in a timed IPC
+
+**/
+
+
+struct thread_wrapper* syscall_timeouts;
 
 
 
@@ -82,8 +248,22 @@
 
 
 PRIVATE u8_t syscall_send(struct thread* th_sender, struct proc* proc_receiver);
-PRIVATE u8_t syscall_receive(struct thread* th_receiver, struct proc* proc_sender);
+PRIVATE u8_t syscall_receive(struct thread* th_receiver, struct proc* proc_sender, struct thread* th_handoff);
 PRIVATE u8_t syscall_notify(struct thread* th_from, struct proc* proc_to);
+PRIVATE u8_t syscall_sendrec(struct thread* th_sender, struct proc* proc_receiver);
+PRIVATE u8_t syscall_reply_receive(struct thread* th, struct proc* proc_client);
+PRIVATE u8_t syscall_mailbox(struct thread* th);
+PRIVATE u8_t syscall_utcb(struct thread* th);
+PRIVATE u8_t syscall_map(struct thread* th_sender, struct proc* proc_receiver);
+PRIVATE u8_t syscall_timed(struct thread* th, struct proc* proc, u32_t syscall_num, u32_t timeout);
+PRIVATE u8_t syscall_receive_set(struct thread* th);
+PRIVATE u8_t syscall_handle_open(struct thread* th, struct proc* proc);
+PRIVATE u8_t syscall_handle_close(struct thread* th);
+PRIVATE u8_t syscall_send_batch(struct thread* th);
+PRIVATE u8_t syscall_channel(struct thread* th, struct proc* proc_consumer);
+PRIVATE u8_t syscall_group(struct thread* th);
+PRIVATE u8_t syscall_group_send(struct thread* th);
+PRIVATE u8_t syscall_window(struct thread* th);
 
 
 /**
@@ -96,11 +276,35 @@ PRIVATE u8_t syscall_notify(struct thread* th_from, struct proc* proc_to);
 **/
 
 
-PRIVATE u8_t syscall_deadlock(struct proc* psender, struct proc* ptarget);
+PRIVATE struct proc* syscall_target(struct proc* proc, u32_t dest);
+PRIVATE u8_t syscall_map_window(struct thread* th_sender, struct proc* proc_receiver);
+PRIVATE u8_t syscall_user_backed(virtaddr_t addr, u32_t len);
+PRIVATE u8_t syscall_deadlock(struct thread* th, struct proc* ptarget);
 PRIVATE struct thread* syscall_find_receiver(struct proc* ptarget, struct proc* pfrom);
-PRIVATE struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom);
+PRIVATE struct thread* syscall_find_receiver_async(struct proc* ptarget, struct proc* pfrom);
+PRIVATE struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom, u32_t* set);
 PRIVATE struct thread* syscall_find_blocked_sender(struct proc* ptarget, struct proc* pfrom);
 PRIVATE u8_t syscall_copymsg( struct thread* src, struct thread* dest);
+PRIVATE void syscall_copymr(struct thread* src, struct thread* dest);
+PRIVATE void syscall_switch(struct thread* th);
+PRIVATE void syscall_recv_enqueue(struct thread* th);
+PRIVATE void syscall_recv_dequeue(struct thread* th);
+PRIVATE void syscall_wait_enqueue(struct proc* proc, struct thread* th);
+PRIVATE void syscall_wait_dequeue(struct proc* proc, struct thread* th);
+PRIVATE u8_t syscall_notify_pending(struct proc* proc, struct proc* pfrom, u32_t* set);
+PRIVATE void syscall_notify_deliver(struct thread* th);
+PRIVATE u8_t syscall_mailbox_put(struct proc* proc, struct thread* th);
+PRIVATE u8_t syscall_mailbox_post(struct proc* proc, pid_t from, u32_t* data);
+PRIVATE u8_t syscall_mailbox_get(struct thread* th, struct proc* pfrom);
+PRIVATE void syscall_timeout_arm(struct thread* th);
+PRIVATE void syscall_timeout_disarm(struct thread* th);
+PRIVATE void syscall_inherit(struct thread* th, struct proc* ptarget);
+PRIVATE void syscall_inherit_walk(struct thread* th, struct proc* p, u32_t* budget);
+PRIVATE void syscall_reinherit(struct thread* th);
+PRIVATE void syscall_reinherit_owners(struct proc* proc, struct thread* th);
+PRIVATE void syscall_serve(struct thread* th, struct thread* client);
+PRIVATE void syscall_disinherit(struct thread* th);
+PRIVATE void syscall_rtt(struct thread* th);
 
 
 /**
@@ -122,6 +326,7 @@ PUBLIC void syscall_handle(void)
   struct proc* target_proc;
   pid_t pid;
   u32_t syscall_num;
+  u32_t timeout;
   u8_t res;
 
   arch_printf("syscall_handle\n");
@@ -135,22 +340,25 @@ PUBLIC void syscall_handle(void)
       goto end;
     }
 
-  /* Get syscall number from source register */
+  /* Get syscall number (and timeout) from source register */
   syscall_num = arch_ctx_get((arch_ctx_t*)th, ARCH_CONST_SOURCE);
+  timeout = syscall_num >> SYSCALL_TIMEOUT_SHIFT;
+  syscall_num &= SYSCALL_NUM_MASK;
 
   /* Put originator proc into source register instead */
   arch_ctx_set((arch_ctx_t*)th, ARCH_CONST_SOURCE,th->proc->pid);
 
   /* Destination proc, stored in EDI */
   pid = (pid_t)arch_ctx_get((arch_ctx_t*)th, ARCH_CONST_DEST);
-  if ( pid == IPC_ANY)
+  if ( (pid == IPC_ANY) || (pid & IPC_GROUP) )
     {
+      /* No proc (group sends get their group from EDI) */
       target_proc = NULL;
     }
   else
     {
-      /* Get proc structure from given id */
-      target_proc = proc_pid(pid);
+      /* Get proc structure from given handle or id */
+      target_proc = syscall_target(th->proc, pid);
       if ( target_proc == NULL )
 	{
 	  res = IPC_FAILURE;
@@ -169,7 +377,7 @@ PUBLIC void syscall_handle(void)
 
     case SYSCALL_RECEIVE:
       {
-	res = syscall_receive(th, target_proc);
+	res = syscall_receive(th, target_proc, NULL);
 	break;
       }
 
@@ -178,6 +386,92 @@ PUBLIC void syscall_handle(void)
 	res = syscall_notify(th, target_proc);
 	break;
       }
+
+    case SYSCALL_SENDREC:
+      {
+	res = syscall_sendrec(th, target_proc);
+	break;
+      }
+
+    case SYSCALL_REPLY_RECEIVE:
+      {
+	res = syscall_reply_receive(th, target_proc);
+	break;
+      }
+
+    case SYSCALL_MAILBOX:
+      {
+	res = syscall_mailbox(th);
+	break;
+      }
+
+    case SYSCALL_UTCB:
+      {
+	res = syscall_utcb(th);
+	break;
+      }
+
+    case SYSCALL_MAP:
+      {
+	res = syscall_map(th, target_proc);
+	break;
+      }
+
+    case SYSCALL_SEND_TIMEOUT:
+    case SYSCALL_RECEIVE_TIMEOUT:
+      {
+	res = syscall_timed(th, target_proc, syscall_num, timeout);
+	break;
+      }
+
+    case SYSCALL_RECEIVE_SET:
+      {
+	res = syscall_receive_set(th);
+	break;
+      }
+
+    case SYSCALL_HANDLE:
+      {
+	res = syscall_handle_open(th, target_proc);
+	break;
+      }
+
+    case SYSCALL_HANDLE_CLOSE:
+      {
+	res = syscall_handle_close(th);
+	break;
+      }
+
+    case SYSCALL_SEND_BATCH:
+      {
+	res = syscall_send_batch(th);
+	break;
+      }
+
+    case SYSCALL_CHANNEL:
+      {
+	res = syscall_channel(th, target_proc);
+	break;
+      }
+
+    case SYSCALL_GROUP:
+      {
+	res = syscall_group(th);
+	break;
+      }
+
+    case SYSCALL_GROUP_SEND:
+      {
+	res = syscall_group_send(th);
+	break;
+      }
+
+    case SYSCALL_WINDOW:
+      {
+	res = syscall_window(th);
+	break;
+      }
+
     default:
       {
 	arch_printf("not a syscall number\n");
@@ -193,6 +487,18 @@ PUBLIC void syscall_handle(void)
 
   arch_printf("end of syscall :%u\n",arch_ctx_get((arch_ctx_t*)th, ARCH_CONST_RETURN));
 
+  /* A thread set ready may outrank caller */
+  sched_preempt();
+
+  /* Timer may be needed sooner (new timeout or thread set ready) */
+  clock_reprogram();
+
+  /* Fast return (SYSEXIT) only if caller still runs */
+  if (th != NULL)
+    {
+      arch_ctx_sysexit((arch_ctx_t*)th, (th == cur_th));
+    }
+
   return;
 }
 
@@ -200,422 +506,2467 @@ PUBLIC void syscall_handle(void)
 
 /**
 
-   Function: u8_t syscall_send(struct thread* th_sender, struct proc* proc_receiver)
-   ---------------------------------------------------------------------------------
+   Function: void syscall_dump(void)
+   ---------------------------------
 
+   Print IPC statistics
 
-   Pass message from `th_sender` to `proc_receiver`.
-   First it checks for deadlock situation (`proc_receiver` sending to `th_sender` proc)
+**/
 
-   Then, if a thread in `proc_receiver` is waiting for the message, it is copied from `th_sender` to that thread,
-   The receiving thread is set ready for scheduling and `th_sender` is set blocked (waiting for a notify call).
 
-   If `proc_receiver` is not waiting for any message, `th_sender` is set as blocked in `proc_receiver` waiting list.
+PUBLIC void syscall_dump(void)
+{
+  arch_printf("IPC: %u deadlocks, fast path %u hits %u misses\n",
+	      syscall_deadlocks,syscall_fast_hits,syscall_fast_misses);
+  arch_printf("IPC: sendrec round trip %u cycles\n",syscall_rtt_cycles);
+
+  return;
+}
+
 
-   At last, scheduler is call because sender will be blocked in any cases.
 
+/**
+
+   Function: void syscall_expire(u32_t now)
+   ----------------------------------------
+
+   Called on each clock interrupt: threads whose timed IPC deadline is reached
+   leave their wait list or receive queue, get IPC_TIMEOUT as result 
+   and are set ready for scheduling.
 
 **/
 
-PRIVATE u8_t syscall_send(struct thread* th_sender, struct proc* proc_receiver)
+
+PUBLIC void syscall_expire(u32_t now)
 {
+  struct thread_wrapper* wrapper;
+  struct thread* th;
 
-  struct thread* th_receiver;
-  
-  /* There must be a receiver - No broadcast allow */
-  if ( proc_receiver == NULL )
+  while(!LLIST_ISNULL(syscall_timeouts))
     {
-      arch_printf("send failed 1\n");
-      return IPC_FAILURE;
-    }
+      /* Look for an expired thread */
+      th = NULL;
+      wrapper = LLIST_GETHEAD(syscall_timeouts);
+      do
+	{
+	  if ((s32_t)(now - wrapper->thread->ipc.deadline) >= 0)
+	    {
+	      th = wrapper->thread;
+	      break;
+	    }
+	  wrapper = LLIST_NEXT(syscall_timeouts,wrapper);
+	}while(!LLIST_ISHEAD(syscall_timeouts,wrapper));
 
-  /* Check for deadlock */
-  if (syscall_deadlock(th_sender->proc,proc_receiver) == IPC_FAILURE)
-    {
-      arch_printf("deadlock\n");
-      return IPC_FAILURE;
+      if (th == NULL)
+	{
+	  break;
+	}
+
+      /* Leave wait (disarms timeout) */
+      if (th->ipc.state & SYSCALL_IPC_SENDING)
+	{
+	  syscall_wait_dequeue(th->ipc.send_to,th);
+	  th->ipc.state &= ~SYSCALL_IPC_SENDING;
+	}
+      else
+	{
+	  syscall_recv_dequeue(th);
+	  th->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+	}
+
+      arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_RETURN,IPC_TIMEOUT);
+
+      /* Ready for scheduling */
+      sched_unblock(th);
     }
 
-  /* No deadlock here, set state */
-  th_sender->ipc.state |= SYSCALL_IPC_SENDING;
+  return;
+}
 
-  /* Set destination */
-  th_sender->ipc.send_to = proc_receiver;
 
-  /* Get a thread willing to receive the message */
-  th_receiver = syscall_find_receiver(proc_receiver,th_sender->proc);
 
-  if (th_receiver != NULL)
-    {
-      /* Found a thread ! copy message from sender to receiver */
-      syscall_copymsg(th_sender,th_receiver);
+/**
 
-      arch_printf("%u sends a message to %u\n",th_sender->proc->pid,proc_receiver->pid);
-  
-      /* Set end of reception */
-      th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+   Function: u32_t syscall_next_timeout(u32_t now)
+   -----------------------------------------------
 
-      /* Ready for scheduling */
-      th_receiver->state = THREAD_READY;
+   Return ticks from `now` to the nearest timed IPC deadline (at least 1),
+   0 if no timeout is armed.
 
-      /* Scheduler queues manipulations */
-      sched_dequeue(SCHED_BLOCKED_QUEUE, th_receiver);
-      sched_enqueue(SCHED_READY_QUEUE, th_receiver);
-      arch_printf("%u unblock %u after send\n",th_sender->proc->pid,proc_receiver->pid);
-       
+**/
 
-      /* Message is delivered to receiver, set end of sending */
-      th_sender->ipc.state &= ~SYSCALL_IPC_SENDING;
 
-       /* Scheduler queues manipulations (blocks sender) */
-      sched_dequeue(SCHED_READY_QUEUE, th_sender);
-      sched_enqueue(SCHED_BLOCKED_QUEUE, th_sender);
-  
-    }
-  else
+PUBLIC u32_t syscall_next_timeout(u32_t now)
+{
+  struct thread_wrapper* wrapper;
+  s32_t delta,next;
+
+  if (LLIST_ISNULL(syscall_timeouts))
     {
-      /* No receiving thread, enqueue in wait list */
-      sched_dequeue(SCHED_READY_QUEUE, th_sender);
-      LLIST_ADD(proc_receiver->wait_list,th_sender);
-  
-      arch_printf("%u in wait list of  %u\n",th_sender->proc->pid,proc_receiver->pid);
-      
+      return 0;
     }
-  
-  /* Sender is blocked, waiting for message processing (must be unblocked via notify) */
-  arch_printf("%u block after send\n",th_sender->proc->pid);
-  th_sender->state = THREAD_BLOCKED;
 
-  /* In any cases, current thread (sender) is blocked, so scheduling is needing */
-  struct thread* th;
-  th = sched_elect();
-
- /* Change address space */
-  if (th->proc)
+  next = 0x7FFFFFFF;
+  wrapper = LLIST_GETHEAD(syscall_timeouts);
+  do
     {
-      arch_switch_addrspace(th->proc->addrspace);
-    }  
-
-  thread_switch_to(th);
+      delta = (s32_t)(wrapper->thread->ipc.deadline - now);
+      if (delta < next)
+	{
+	  next = delta;
+	}
+      wrapper = LLIST_NEXT(syscall_timeouts,wrapper);
+    }while(!LLIST_ISHEAD(syscall_timeouts,wrapper));
 
-  return IPC_SUCCESS;
+  return (next > 0 ? (u32_t)next : 1);
 }
 
 
 
-/**
-
-   Function: u8_t syscall_receive(struct thread* th_receiver, struct thread* th_sender)
-   ------------------------------------------------------------------------------------
 
+/**
 
-   Set up the receiving state for `th_receiver`.
-   If `th_sender` is in its waiting list, retrieve sender's message and unblock sender.
-   Otherwise, `th_receiver` will blocked, waiting for `th_sender`.
+   Function: void syscall_cancel(struct thread* th)
+   ------------------------------------------------
 
+   Called before `th` is destroyed: take it out of every IPC queue it is blocked in
+   (wait list of its receiver or receive queue of its process, which disarms its
+   timeout), and release the server thread still serving it if it was waiting for
+   a reply.
 
 **/
 
-PRIVATE u8_t syscall_receive(struct thread* th_receiver, struct proc* proc_sender)
-{
-  struct thread* th_available = NULL;
-
-  /* Set receive state */
-  th_receiver->ipc.state |= SYSCALL_IPC_RECEIVING;
 
-  /* Set thread to receive from (can be NULL) */
-  th_receiver->ipc.recv_from = proc_sender;
+PUBLIC void syscall_cancel(struct thread* th)
+{
+  struct thread_wrapper* wrapper;
+
+  if (th->ipc.state & SYSCALL_IPC_SENDING)
+    {
+      syscall_wait_dequeue(th->ipc.send_to,th);
+    }
+  else if (th->ipc.state & SYSCALL_IPC_RECEIVING)
+    {
+      /* Waiting for a reply: the server serving us is in the process we receive from */
+      if ( (th->ipc.recv_from != NULL) && (!LLIST_ISNULL(th->ipc.recv_from->thread_list)) )
+	{
+	  wrapper = LLIST_GETHEAD(th->ipc.recv_from->thread_list);
+	  do
+	    {
+	      if (wrapper->thread->ipc.client == th)
+		{
+		  syscall_disinherit(wrapper->thread);
+		}
+	      wrapper = LLIST_NEXT(th->ipc.recv_from->thread_list,wrapper);
+	    }while(!LLIST_ISHEAD(th->ipc.recv_from->thread_list,wrapper));
+	}
+
+      syscall_recv_dequeue(th);
+    }
+
+  th->ipc.state = 0;
+  th->ipc.client = NULL;
+
+  return;
+}
+
+
+/**
+
+   Function: arch_ctx_t* syscall_fastpath(u32_t syscall_num, u32_t dest)
+   ---------------------------------------------------------------------
+
+   IPC fast path, called from the low level syscall entry with only the caller
+   registers saved.
+
+   It handles the common RPC case: a sendrec (or a reply_receive) to another process
+   where a thread is already waiting for the message, and where the caller has to block.
+   The caller is blocked and the waiting thread becomes the current one (handoff).
+   Results and timer match the regular path: reply status in destination register
+   of a reply_receive, one-shot timer reprogrammed for the new current thread.
+
+   Return the context of the new current thread, in which the low level entry
+   copies the message registers before returning to it.
+   Return NULL without touching anything if the call does not fit, so the
+   regular `syscall_handle` path takes it.
+
+**/
+
+
+PUBLIC arch_ctx_t* syscall_fastpath(u32_t syscall_num, u32_t dest)
+{
+  struct thread* th = cur_th;
+  struct thread* th_receiver;
+  struct proc* target_proc;
+
+  if ( (!SYSCALL_HANDOFF) || (th == NULL) || (th->proc == NULL) || (dest == IPC_ANY) )
+    {
+      goto miss;
+    }
+
+  /* Registers only message */
+  if ( (th->ipc.utcb != NULL) && (th->ipc.utcb->send_len) )
+    {
+      goto miss;
+    }
+
+  /* Receiver must be in another process */
+  target_proc = syscall_target(th->proc, dest);
+  if ( (target_proc == NULL) || (target_proc == th->proc) )
+    {
+      goto miss;
+    }
+
+  /* And waiting for the message */
+  th_receiver = syscall_find_receiver(target_proc,th->proc);
+  if (th_receiver == NULL)
+    {
+      goto miss;
+    }
+
+  switch(syscall_num)
+    {
+    case SYSCALL_SENDREC:
+      {
+	if (syscall_deadlock(th,target_proc) == IPC_FAILURE)
+	  {
+	    goto miss;
+	  }
+
+	/* Caller waits for the reply */
+	th->ipc.state = SYSCALL_IPC_RECEIVING|SYSCALL_IPC_SENDREC;
+	th->ipc.send_to = target_proc;
+	th->ipc.recv_from = target_proc;
+	th->ipc.rtt_start = arch_cycles();
+
+	/* Receiver serves the caller at its priority */
+	syscall_serve(th_receiver,th);
+	break;
+      }
+
+    case SYSCALL_REPLY_RECEIVE:
+      {
+	/* Receiver must wait for a reply and caller must have nothing to receive */
+	if ( (!(th_receiver->ipc.state & SYSCALL_IPC_SENDREC))
+	     || (syscall_find_waiting_sender(th->proc,NULL,NULL) != NULL)
+	     || syscall_notify_pending(th->proc,NULL,NULL)
+	     || ( (th->proc->mailbox != NULL) && (th->proc->mailbox->count) ) )
+	  {
+	    goto miss;
+	  }
+
+	/* Caller waits for next message, reply status as in `syscall_reply_receive` */
+	th->ipc.state = SYSCALL_IPC_RECEIVING;
+	th->ipc.recv_from = NULL;
+	arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_DEST,IPC_SUCCESS);
+
+	/* Client is served */
+	syscall_disinherit(th);
+	syscall_rtt(th_receiver);
+	break;
+      }
+
+    default:
+      {
+	goto miss;
+      }
+    }
+
+  /* Caller is now a receiver */
+  syscall_recv_enqueue(th);
+
+  /* Message source (registers are copied by caller) */
+  arch_ctx_set((arch_ctx_t*)th_receiver,ARCH_CONST_SOURCE,th->proc->pid);
+  syscall_copymr(NULL,th_receiver);
+  
+  /* End of reception */
+  syscall_recv_dequeue(th_receiver);
+  th_receiver->ipc.state &= ~(SYSCALL_IPC_RECEIVING|SYSCALL_IPC_SENDREC);
+  sched_unblock(th_receiver);
+
+  /* Block caller */
+  sched_block(th);
+
+  /* Hand off: caller will return the regular way */
+  syscall_switch(th_receiver);
+  arch_ctx_sysexit((arch_ctx_t*)th, FALSE);
+
+  /* Timer follows the new current thread, as at the end of `syscall_handle` */
+  clock_reprogram();
+
+  syscall_fast_hits++;
+
+  return (arch_ctx_t*)th_receiver;
+
+ miss:
+
+  syscall_fast_misses++;
+
+  return NULL;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_send(struct thread* th_sender, struct proc* proc_receiver)
+   ---------------------------------------------------------------------------------
+
+
+   Pass message from `th_sender` to `proc_receiver`.
+   First it checks for deadlock situation (`proc_receiver` sending to `th_sender` proc)
+
+   Then, if a thread in `proc_receiver` is waiting for the message, it is copied from `th_sender` to that thread,
+   The receiving thread is set ready for scheduling and `th_sender` is set blocked (waiting for a notify call).
+
+   If `proc_receiver` is not waiting for any message, `th_sender` is set as blocked in `proc_receiver` waiting list.
+
+   If the receiving thread was waiting for the reply to a sendrec, no notify will follow:
+   `th_sender` is not blocked and returns immediately.
+   If `th_sender` is itself in a sendrec, it waits for the reply from `proc_receiver` instead of a notify.
+
+   A timed send waits in the wait list until its deadline at most (IPC_TIMEOUT then), and
+   gives up at once with IPC_TIMEOUT if its timeout is IPC_TIMEOUT_POLL. The timeout only covers
+   delivery: once delivered, it waits for the notify like a regular send.
+
+   If `proc_receiver` has a mailbox, send is asynchronous (except for a sendrec): 
+   `th_sender` is not blocked once the message is delivered to a receiving thread or 
+   stored in the mailbox. It blocks in the wait list only if the mailbox is full.
+
+   At last, scheduler is call because sender will be blocked.
+
+
+**/
+
+PRIVATE u8_t syscall_send(struct thread* th_sender, struct proc* proc_receiver)
+{
+
+  struct thread* th_receiver;
+  u8_t reply;
+  u8_t async;
+  
+  /* There must be a receiver - No broadcast allow */
+  if ( proc_receiver == NULL )
+    {
+      arch_printf("send failed 1\n");
+      return IPC_FAILURE;
+    }
+
+  /* Check for deadlock */
+  if (syscall_deadlock(th_sender,proc_receiver) == IPC_FAILURE)
+    {
+      arch_printf("deadlock\n");
+      return IPC_FAILURE;
+    }
+
+  /* No deadlock here, set state */
+  th_sender->ipc.state |= SYSCALL_IPC_SENDING;
+
+  /* Set destination */
+  th_sender->ipc.send_to = proc_receiver;
+
+  /* Asynchronous send to a mailbox ? (a sendrec still waits for the reply) */
+  async = (proc_receiver->mailbox != NULL) && !(th_sender->ipc.state & SYSCALL_IPC_SENDREC);
+
+  /* Get a thread willing to receive the message */
+  th_receiver = syscall_find_receiver(proc_receiver,th_sender->proc);
+
+  if (th_receiver != NULL)
+    {
+      /* Found a thread ! copy message from sender to receiver */
+      syscall_copymsg(th_sender,th_receiver);
+
+      arch_printf("%u sends a message to %u\n",th_sender->proc->pid,proc_receiver->pid);
+
+      /* Is it the reply to a sendrec ? */
+      reply = th_receiver->ipc.state & SYSCALL_IPC_SENDREC;
+  
+      /* Set end of reception */
+      syscall_recv_dequeue(th_receiver);
+      th_receiver->ipc.state &= ~(SYSCALL_IPC_RECEIVING|SYSCALL_IPC_SENDREC);
+
+      /* Ready for scheduling */
+      sched_unblock(th_receiver);
+      arch_printf("%u unblock %u after send\n",th_sender->proc->pid,proc_receiver->pid);
+       
+
+      /* Message is delivered to receiver, set end of sending (timeout only covers delivery) */
+      th_sender->ipc.state &= ~(SYSCALL_IPC_SENDING|SYSCALL_IPC_TIMED);
+
+      if (th_sender->ipc.state & SYSCALL_IPC_SENDREC)
+	{
+	  /* Sendrec: wait for the reply from receiver instead of a notify */
+	  th_sender->ipc.state |= SYSCALL_IPC_RECEIVING;
+	  th_sender->ipc.recv_from = proc_receiver;
+	  syscall_recv_enqueue(th_sender);
+	}
+      else if (reply || async)
+	{
+	  /* Reply to a sendrec: client is served, drop its priority */
+	  if (reply)
+	    {
+	      syscall_disinherit(th_sender);
+	      syscall_rtt(th_receiver);
+	    }
+	  else
+	    {
+	      /* Asynchronous: receiver must not notify */
+	      SYSCALL_NOTIFY_SKIP(proc_receiver,th_sender->proc->pid);
+	    }
+
+	  /* Reply to a sendrec or asynchronous send: nobody will notify, sender keeps running */
+	  return IPC_SUCCESS;
+	}
+
+      /* Sender waits for receiver: receiver serves it at its priority */
+      syscall_serve(th_receiver,th_sender);
+
+      /* Block sender (lazily, it stays in ready queue) */
+      sched_block(th_sender);
+  
+    }
+  else if ( async && (syscall_mailbox_put(proc_receiver,th_sender) == IPC_SUCCESS) )
+    {
+      /* Message is in the mailbox, set end of sending */
+      th_sender->ipc.state &= ~SYSCALL_IPC_SENDING;
+
+      arch_printf("%u posts a message to %u\n",th_sender->proc->pid,proc_receiver->pid);
+
+      return IPC_SUCCESS;
+    }
+  else if ( (th_sender->ipc.state & SYSCALL_IPC_TIMED) && (th_sender->ipc.deadline == IPC_TIMEOUT_POLL) )
+    {
+      /* Poll: do not wait */
+      th_sender->ipc.state &= ~(SYSCALL_IPC_SENDING|SYSCALL_IPC_TIMED);
+
+      return IPC_TIMEOUT;
+    }
+  else
+    {
+      /* No receiving thread, enqueue in wait list */
+      sched_block(th_sender);
+      syscall_wait_enqueue(proc_receiver,th_sender);
+
+      if (th_sender->ipc.state & SYSCALL_IPC_TIMED)
+	{
+	  syscall_timeout_arm(th_sender);
+	}
+
+      /* Receiver (and the chain it waits for) runs at least at sender priority */
+      syscall_inherit(th_sender,proc_receiver);
+  
+      arch_printf("%u in wait list of  %u\n",th_sender->proc->pid,proc_receiver->pid);
+      
+    }
+  
+  /* Sender is blocked, waiting for message processing (must be unblocked via notify) */
+  arch_printf("%u block after send\n",th_sender->proc->pid);
+
+  /* In any cases, current thread (sender) is blocked: hand off to receiver if any */
+  syscall_switch(th_receiver);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_receive(struct thread* th_receiver, struct proc* proc_sender, struct thread* th_handoff)
+   ---------------------------------------------------------------------------------------------------------------
+
+
+   Set up the receiving state for `th_receiver`.
+   Pending notifications are delivered first, then mailbox messages (the oldest
+   sender in wait list then takes the freed slot).
+   If `th_sender` is in its waiting list, retrieve sender's message and unblock sender
+   (or make it wait for the reply if it is in a sendrec).
+   Otherwise, `th_receiver` will blocked, waiting for `th_sender`, and `th_handoff` (if not NULL)
+   is the thread to switch to. A timed receive gives up with IPC_TIMEOUT instead if its 
+   timeout is IPC_TIMEOUT_POLL.
+
+
+**/
+
+PRIVATE u8_t syscall_receive(struct thread* th_receiver, struct proc* proc_sender, struct thread* th_handoff)
+{
+  struct thread* th_available = NULL;
+  u32_t* set = NULL;
+
+  /* Set receive state */
+  th_receiver->ipc.state |= SYSCALL_IPC_RECEIVING;
+
+  /* Set thread to receive from (can be NULL) */
+  th_receiver->ipc.recv_from = proc_sender;
+
+  /* Or sources set */
+  if (th_receiver->ipc.state & SYSCALL_IPC_SET)
+    {
+      set = th_receiver->ipc.recv_set;
+    }
+
+  /* Pending notifications come first */
+  if (syscall_notify_pending(th_receiver->proc, proc_sender, set))
+    {
+      syscall_notify_deliver(th_receiver);
+      th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+
+      return IPC_SUCCESS;
+    }
+
+  /* Then mailbox messages */
+  if (syscall_mailbox_get(th_receiver, proc_sender) == IPC_SUCCESS)
+    {
+      th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+
+      /* Move oldest waiting sender into the freed slot */
+      th_available = syscall_find_waiting_sender(th_receiver->proc, NULL, NULL);
+      if ( (th_available != NULL) 
+	   && !(th_available->ipc.state & SYSCALL_IPC_SENDREC)
+	   && (syscall_mailbox_put(th_receiver->proc, th_available) == IPC_SUCCESS) )
+	{
+	  syscall_wait_dequeue(th_receiver->proc, th_available);
+	  th_available->ipc.state &= ~SYSCALL_IPC_SENDING;
+
+	  sched_unblock(th_available);
+	}
+
+      return IPC_SUCCESS;
+    }
 
   /* Find a thread sending to me */
-  th_available = syscall_find_waiting_sender(th_receiver->proc, proc_sender);
+  th_available = syscall_find_waiting_sender(th_receiver->proc, proc_sender, set);
  
   /* A matching sender found ? */
   if ( th_available != NULL )
     {
-      /* Copy message from sender to receiver */ 
-      syscall_copymsg(th_available,th_receiver);
- 
-      arch_printf("%u receives a message from %u\n",th_receiver->proc->pid,th_available->proc->pid);
+      /* Copy message from sender to receiver */ 
+      syscall_copymsg(th_available,th_receiver);
+ 
+      arch_printf("%u receives a message from %u\n",th_receiver->proc->pid,th_available->proc->pid);
+
+      /* Set end of sending */
+      th_available->ipc.state &= ~SYSCALL_IPC_SENDING;
+
+      /* Remove sender from receiver waiting list */
+      syscall_wait_dequeue(th_receiver->proc, th_available);
+
+      if (th_available->ipc.state & SYSCALL_IPC_SENDREC)
+	{
+	  /* Sendrec: sender now waits for the reply (stays blocked) */
+	  th_available->ipc.state |= SYSCALL_IPC_RECEIVING;
+	  th_available->ipc.recv_from = th_receiver->proc;
+	  syscall_recv_enqueue(th_available);
+
+	  /* Serve it at its priority */
+	  syscall_serve(th_receiver,th_available);
+	}
+      else
+	{
+	  /* Unblock sender, set it as ready for scheduling (no notify expected) */
+	  sched_unblock(th_available);
+	  SYSCALL_NOTIFY_SKIP(th_receiver->proc,th_available->proc->pid);
+
+	  arch_printf("%u unblock  %u from its wait list\n",th_receiver->proc->pid,th_available->proc->pid);
+	}
+
+      /* End of reception */
+      th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+      
+    }
+  else if ( (th_receiver->ipc.state & SYSCALL_IPC_TIMED) && (th_receiver->ipc.deadline == IPC_TIMEOUT_POLL) )
+    {
+      /* Poll: do not wait */
+      th_receiver->ipc.state &= ~(SYSCALL_IPC_RECEIVING|SYSCALL_IPC_TIMED);
+
+      return IPC_TIMEOUT;
+    }
+  else
+    {
+      /* No matching sender found: blocked waiting for a sender */
+      syscall_recv_enqueue(th_receiver);
+
+      if (th_receiver->ipc.state & SYSCALL_IPC_TIMED)
+	{
+	  syscall_timeout_arm(th_receiver);
+	}
+
+      /* Block receiver (lazily, it stays in ready queue) */
+      sched_block(th_receiver);
+
+      arch_printf("%u blocked cause no message available\n",th_receiver->proc->pid);
+
+      /* Current thread (receiver) is blocked, need scheduling */
+      syscall_switch(th_handoff);
+      
+    }
+  
+  return IPC_SUCCESS;
+}
+
+
+/**
+
+   u8_t syscall_notify(struct thread* th_from, struct proc* proc_to)
+   -----------------------------------------------------------------
+
+   Send a notification from `th_from` to `proc_to`. Never blocks.
+
+   If a thread of `proc_to` is blocked sending to `th_from` process, the notification
+   tells it that message processing is finished: it is simply set ready for scheduling.
+
+   If `th_from` process took a message from `proc_to` which did not block its sender
+   (mailbox, batch or group send, sender taken from wait list), the notification only 
+   acknowledges it and nobody waits for it: it is dropped (see `SYSCALL_NOTIFY_SKIP`).
+
+   Otherwise the notification is asynchronous: `th_from` process bit is set in `proc_to`
+   pending bitmap, and the bitmap is delivered to a thread of `proc_to` receiving it if any,
+   or on the next receive.
+
+**/
+
+PRIVATE u8_t syscall_notify(struct thread* th_from, struct proc* proc_to)
+{
+  struct thread* th;
+  pid_t pid;
+
+  if (proc_to == NULL)
+    {
+      return IPC_FAILURE;
+    }
+
+  th = syscall_find_blocked_sender(th_from->proc,proc_to);
+  if (th != NULL)
+    {
+      arch_printf("%u unblocks %u via notify\n",th_from->proc->pid,proc_to->pid);
+      
+      /* End of sending */
+      th->ipc.state &= ~SYSCALL_IPC_SENDING;
+      
+      /* Recipient is ready for scheduling */
+      sched_unblock(th);
+
+      /* Sender is served, drop its priority */
+      syscall_disinherit(th_from);
+
+      return IPC_SUCCESS;
+    }
+
+  /* Acknowledgement of a message whose sender did not wait: drop it */
+  if (th_from->proc->notify_skip[proc_to->pid])
+    {
+      th_from->proc->notify_skip[proc_to->pid]--;
+      return IPC_SUCCESS;
+    }
+
+  /* Nobody to unblock: notification becomes pending */
+  pid = th_from->proc->pid;
+  proc_to->notify_pending[SYSCALL_NOTIFY_WORD(pid)] |= SYSCALL_NOTIFY_BIT(pid);
+
+  /* Look for a thread receiving it (a sendrec waits for a reply instead) */
+  th = syscall_find_receiver_async(proc_to,th_from->proc);
+
+  if (th != NULL)
+    {
+      /* Deliver pending notifications (before dequeue, which drops the receive set) */
+      syscall_notify_deliver(th);
+      syscall_recv_dequeue(th);
+      th->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+
+      /* Receiver is ready for scheduling */
+      sched_unblock(th);
+
+      arch_printf("%u notifies %u\n",th_from->proc->pid,proc_to->pid);
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_sendrec(struct thread* th_sender, struct proc* proc_receiver)
+   ------------------------------------------------------------------------------------
+
+   Send a message from `th_sender` to `proc_receiver` and wait for the reply,
+   in a single kernel entry.
+
+   Simply flag `th_sender` then rely on `syscall_send`, which makes it wait 
+   for the reply once the message is delivered. The receiver replies with a 
+   simple send, no notify is needed.
+
+**/
+
+PRIVATE u8_t syscall_sendrec(struct thread* th_sender, struct proc* proc_receiver)
+{
+  u8_t res;
+
+  /* Set sendrec state */
+  th_sender->ipc.state |= SYSCALL_IPC_SENDREC;
+  th_sender->ipc.rtt_start = arch_cycles();
+
+  res = syscall_send(th_sender, proc_receiver);
+  if (res != IPC_SUCCESS)
+    {
+      th_sender->ipc.state &= ~SYSCALL_IPC_SENDREC;
+    }
+
+  return res;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_reply_receive(struct thread* th, struct proc* proc_client)
+   ---------------------------------------------------------------------------------
+
+   Reply to `proc_client` then wait for the next message from ANY, in a single kernel entry.
+
+   The reply is delivered only if a thread of `proc_client` is waiting for it 
+   (ie. in a sendrec to `th` process). A client no longer waiting (plain send, timeout, death)
+   is not fatal: the reply is dropped and `th` still waits for the next message.
+   Reply status is returned in the destination register, receive status as result.
+   If `proc_client` is NULL, there is nothing to reply and it acts as a simple receive.
+
+**/
+
+PRIVATE u8_t syscall_reply_receive(struct thread* th, struct proc* proc_client)
+{
+  struct thread* th_client = NULL;
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_DEST,IPC_SUCCESS);
+
+  if (proc_client != NULL)
+    {
+      /* Find the thread waiting for the reply */
+      th_client = syscall_find_receiver(proc_client, th->proc);
+      if ( (th_client == NULL) || !(th_client->ipc.state & SYSCALL_IPC_SENDREC) )
+	{
+	  /* Reply is lost, but server goes on receiving */
+	  arch_printf("%u has no reply to wait for in %u\n",th->proc->pid,proc_client->pid);
+	  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_DEST,IPC_FAILURE);
+	  return syscall_receive(th, NULL, NULL);
+	}
+
+      /* Copy reply */
+      syscall_copymsg(th,th_client);
+
+      /* End of client sendrec */
+      syscall_recv_dequeue(th_client);
+      th_client->ipc.state &= ~(SYSCALL_IPC_RECEIVING|SYSCALL_IPC_SENDREC);
+
+      /* Client is ready for scheduling */
+      sched_unblock(th_client);
+
+      /* Client is served, drop its priority */
+      syscall_disinherit(th);
+      syscall_rtt(th_client);
+
+      arch_printf("%u replies to %u\n",th->proc->pid,proc_client->pid);
+    }
+
+  /* Wait for next message, handing off to client if blocked */
+  return syscall_receive(th, NULL, th_client);
+}
+
+
+
+/**
+
+   Function: u8_t syscall_mailbox(struct thread* th)
+   -------------------------------------------------
+
+   Give `th` process an asynchronous mailbox.
+
+**/
+
+PRIVATE u8_t syscall_mailbox(struct thread* th)
+{
+  if (proc_mailbox(th->proc) != EXIT_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_utcb(struct thread* th)
+   ----------------------------------------------
+
+   Give `th` an UTCB and return its user address in first message register.
+
+**/
+
+PRIVATE u8_t syscall_utcb(struct thread* th)
+{
+  if (thread_utcb(th) != EXIT_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,th->ipc.utcb_user);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_map(struct thread* th_sender, struct proc* proc_receiver)
+   --------------------------------------------------------------------------------
+
+   Map (or grant) `th_sender` pages into `proc_receiver` then send the message
+   describing them: source address, pages count (with IPC_MAP_GRANT flag) and destination address.
+   Pages are mapped at once, whether a receiver is waiting or not.
+
+   Pages only go to the receive window `proc_receiver` opened (see `syscall_window`).
+
+**/
+
+PRIVATE u8_t syscall_map(struct thread* th_sender, struct proc* proc_receiver)
+{
+  if (syscall_map_window(th_sender,proc_receiver) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  return syscall_send(th_sender,proc_receiver);
+}
+
+
+
+/**
+
+   Function: u8_t syscall_map_window(struct thread* th_sender, struct proc* proc_receiver)
+   ---------------------------------------------------------------------------------------
+
+   Map (or grant) `th_sender` pages given in message registers at the base of
+   `proc_receiver` receive window, which becomes the destination address.
+   The window is closed by a successful map, so the receiver consents to each 
+   map separately. Nothing is mapped if the send to follow would fail.
+
+**/
+
+PRIVATE u8_t syscall_map_window(struct thread* th_sender, struct proc* proc_receiver)
+{
+  u32_t count;
+  virtaddr_t dest;
+
+  if ( (proc_receiver == NULL) || (proc_receiver == th_sender->proc) )
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Do not map anything if send would fail */
+  if (syscall_deadlock(th_sender,proc_receiver) == IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Pages must fit in receiver window */
+  count = arch_ctx_get((arch_ctx_t*)th_sender,ARCH_CONST_MSG2);
+  if ( (count & ~IPC_MAP_GRANT) > proc_receiver->window_pages )
+    {
+      return IPC_FAILURE;
+    }
+  dest = proc_receiver->window;
+
+  if (proc_map(proc_receiver,
+	       arch_ctx_get((arch_ctx_t*)th_sender,ARCH_CONST_MSG1),
+	       dest,
+	       count & ~IPC_MAP_GRANT,
+	       (count & IPC_MAP_GRANT)?TRUE:FALSE) != EXIT_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  proc_receiver->window_pages = 0;
+  arch_ctx_set((arch_ctx_t*)th_sender,ARCH_CONST_MSG3,dest);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_window(struct thread* th)
+   ------------------------------------------------
+
+   Open `th` process receive window at address given by first message register,
+   for the number of pages given by second one (0 closes it). 
+   Only free pages of the window can be mapped by others.
+
+**/
+
+PRIVATE u8_t syscall_window(struct thread* th)
+{
+  virtaddr_t base;
+  u32_t npages;
+
+  base = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  npages = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2);
+
+  /* Window must be in user space */
+  if ( (npages) 
+       && ( (npages > PROC_MAP_MAX) || (base & (ARCH_CONST_PAGE_SIZE-1)) 
+	    || (base < ARCH_CONST_KERN_HIGHMEM) || (base + npages*ARCH_CONST_PAGE_SIZE - 1 < base) ) )
+    {
+      return IPC_FAILURE;
+    }
+
+  th->proc->window = base;
+  th->proc->window_pages = npages;
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_timed(struct thread* th, struct proc* proc, u32_t syscall_num, u32_t timeout)
+   ----------------------------------------------------------------------------------------------------
+
+   Timed send (to `proc`) or receive (from `proc`) on behalf of `th`.
+   `timeout` is in clock ticks, IPC_TIMEOUT_POLL does not block and 
+   IPC_TIMEOUT_NEVER acts as a regular call.
+
+**/
+
+PRIVATE u8_t syscall_timed(struct thread* th, struct proc* proc, u32_t syscall_num, u32_t timeout)
+{
+  u8_t res;
+
+  if (timeout != IPC_TIMEOUT_NEVER)
+    {
+      th->ipc.state |= SYSCALL_IPC_TIMED;
+      th->ipc.deadline = timeout;
+    }
+
+  if (syscall_num == SYSCALL_SEND_TIMEOUT)
+    {
+      res = syscall_send(th, proc);
+    }
+  else
+    {
+      res = syscall_receive(th, proc, NULL);
+    }
+
+  /* Timeout only lasts while blocked */
+  if (th->state != THREAD_BLOCKED)
+    {
+      th->ipc.state &= ~SYSCALL_IPC_TIMED;
+    }
+
+  return res;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_receive_set(struct thread* th)
+   -----------------------------------------------------
+
+   Receive on behalf of `th` from any source in the set passed in its
+   first message registers. See `syscall_find_waiting_sender` for priorities.
+
+**/
+
+PRIVATE u8_t syscall_receive_set(struct thread* th)
+{
+  u8_t res;
+
+  th->ipc.recv_set[0] = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  th->ipc.recv_set[1] = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2);
+  th->ipc.state |= SYSCALL_IPC_SET;
+
+  res = syscall_receive(th, NULL, NULL);
+
+  /* Set only lasts while blocked */
+  if (th->state != THREAD_BLOCKED)
+    {
+      th->ipc.state &= ~SYSCALL_IPC_SET;
+    }
+
+  return res;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_handle_open(struct thread* th, struct proc* proc)
+   ------------------------------------------------------------------------
+
+   Give `th` process an endpoint handle on `proc`.
+   Return it in first message register, with IPC_HANDLE flag.
+
+**/
+
+PRIVATE u8_t syscall_handle_open(struct thread* th, struct proc* proc)
+{
+  u32_t handle;
+
+  if (proc_handle_open(th->proc, proc, &handle) != EXIT_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,handle|IPC_HANDLE);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_handle_close(struct thread* th)
+   ------------------------------------------------------
+
+   Release `th` process endpoint handle found in first message register.
+
+**/
+
+PRIVATE u8_t syscall_handle_close(struct thread* th)
+{
+  u32_t handle;
+
+  handle = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1) & ~IPC_HANDLE;
+  if (proc_handle_close(th->proc, handle) != EXIT_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_send_batch(struct thread* th)
+   ----------------------------------------------------
+
+   Send on behalf of `th` the messages of the user batch given by first message
+   register (address) and second one (count), in a single kernel entry.
+
+   Each entry is a registers only message delivered right away, like an asynchronous
+   send: to a thread receiving it, or in the destination mailbox. So the batch never 
+   blocks, and delivery stops at the first entry which can not be delivered
+   (unknown or group destination, no receiver and no room in mailbox). 
+   The number of delivered entries is returned in first message register.
+   `th` other registers and UTCB message registers are left untouched.
+
+   Batch is read in `th` address space, which is the current one (nothing switches).
+   It must be backed as a whole, otherwise nothing is sent, and each entry is 
+   copied in before use, so a bad pointer never faults in kernel.
+
+**/
+
+PRIVATE u8_t syscall_send_batch(struct thread* th)
+{
+  struct ipc_batch* batch;
+  struct ipc_batch entry;
+  struct proc* proc;
+  struct thread* th_receiver;
+  u32_t* data;
+  u32_t n,i;
+
+  batch = (struct ipc_batch*)arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  n = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2);
+
+  /* Batch must be in user space */
+  if ( (n > IPC_BATCH_MAX) || ((virtaddr_t)batch < ARCH_CONST_KERN_HIGHMEM)
+       || ((virtaddr_t)(batch+n) < (virtaddr_t)batch) )
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (n) && (syscall_user_backed((virtaddr_t)batch,n*sizeof(struct ipc_batch)) != IPC_SUCCESS) )
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<n;i++)
+    {
+      arch_memcopy((addr_t)&batch[i],(addr_t)&entry,sizeof(struct ipc_batch));
+
+      /* No group in a batch */
+      if (entry.to & IPC_GROUP)
+	{
+	  break;
+	}
+
+      proc = syscall_target(th->proc, entry.to);
+      if (proc == NULL)
+	{
+	  break;
+	}
+
+      data = (u32_t*)entry.msg.data;
+
+      th_receiver = syscall_find_receiver_async(proc,th->proc);
+      if (th_receiver != NULL)
+	{
+	  arch_ctx_set((arch_ctx_t*)th_receiver,ARCH_CONST_SOURCE,th->proc->pid);
+	  arch_ctx_set((arch_ctx_t*)th_receiver,ARCH_CONST_MSG1,data[0]);
+	  arch_ctx_set((arch_ctx_t*)th_receiver,ARCH_CONST_MSG2,data[1]);
+	  arch_ctx_set((arch_ctx_t*)th_receiver,ARCH_CONST_MSG3,data[2]);
+	  syscall_copymr(NULL,th_receiver);
+
+	  /* End of reception */
+	  syscall_recv_dequeue(th_receiver);
+	  th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+	  sched_unblock(th_receiver);
+	}
+      else if (syscall_mailbox_post(proc,th->proc->pid,data) != IPC_SUCCESS)
+	{
+	  break;
+	}
+
+      /* Nobody waits: receiver must not notify */
+      SYSCALL_NOTIFY_SKIP(proc,th->proc->pid);
+    }
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,i);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_channel(struct thread* th, struct proc* proc_consumer)
+   -----------------------------------------------------------------------------
+
+   Set up a channel from `th` process to `proc_consumer`: free pages given in message
+   registers (address and count) are backed by pages from pager0, cleared and given 
+   the ring header through a kernel alias, then mapped in `proc_consumer` receive 
+   window (as with `syscall_map`) along with the message describing them.
+   Ring pages are released if they can not be mapped. Once mapped, they are shared
+   (referenced once per process in pager0) and freed when both endpoints are destroyed.
+
+   Kernel is not involved in records transfer afterwards, only in notifications.
+
+**/
+
+PRIVATE u8_t syscall_channel(struct thread* th, struct proc* proc_consumer)
+{
+  struct ipc_channel* ch;
+  virtaddr_t src,kaddr;
+  physaddr_t paddr;
+  u32_t npages,size,i;
+
+  src = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  npages = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2);
+
+  /* Ring must be in user space, other checks are left to `proc_map` */
+  if ( (proc_consumer == NULL) || (npages == 0) || (npages > PROC_MAP_MAX)
+       || (src & (ARCH_CONST_PAGE_SIZE-1)) || (src < ARCH_CONST_KERN_HIGHMEM)
+       || (src + npages*ARCH_CONST_PAGE_SIZE - 1 < src) )
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Capacity rounded down to a power of 2 */
+  size = (npages*ARCH_CONST_PAGE_SIZE - sizeof(struct ipc_channel))/(IPC_CHANNEL_REC*sizeof(u32_t));
+  for(i=1;(i<<1)<=size;i<<=1)
+    {}
+  size = i;
+
+  /* Back ring pages explicitly */
+  for(i=0;i<npages;i++)
+    {
+      paddr = pager0_alloc();
+      if (paddr == PAGER0_ERROR)
+	{
+	  goto err;
+	}
+
+      if (pager0_user_map(src+i*ARCH_CONST_PAGE_SIZE,paddr) != EXIT_SUCCESS)
+	{
+	  pager0_free(paddr);
+	  goto err;
+	}
+
+      kaddr = pager0_alias(paddr);
+      if (kaddr == PAGER0_ERROR)
+	{
+	  arch_user_unmap(src+i*ARCH_CONST_PAGE_SIZE);
+	  pager0_free(paddr);
+	  goto err;
+	}
+
+      arch_memset(0,kaddr,ARCH_CONST_PAGE_SIZE);
+
+      /* Ring header at head */
+      if (i == 0)
+	{
+	  ch = (struct ipc_channel*)kaddr;
+	  ch->head = 0;
+	  ch->tail = 0;
+	  ch->size = size;
+	  ch->producer = th->proc->pid;
+	  ch->consumer = proc_consumer->pid;
+	}
+
+      pager0_unalias(kaddr);
+    }
+
+  /* Share it */
+  if (syscall_map_window(th,proc_consumer) != IPC_SUCCESS)
+    {
+      goto err;
+    }
+
+  return syscall_send(th,proc_consumer);
+
+ err:
+  /* Release ring pages backed so far */
+  while(i--)
+    {
+      paddr = arch_tophys(src+i*ARCH_CONST_PAGE_SIZE);
+      arch_user_unmap(src+i*ARCH_CONST_PAGE_SIZE);
+      pager0_free(paddr);
+    }
+
+  return IPC_FAILURE;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_group(struct thread* th)
+   -----------------------------------------------
+
+   Make `th` process join (second message register is TRUE) or leave
+   the group given in first message register.
+
+**/
+
+PRIVATE u8_t syscall_group(struct thread* th)
+{
+  u32_t group;
+  u8_t res;
+
+  group = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  if (arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2))
+    {
+      res = proc_group_join(th->proc,group);
+    }
+  else
+    {
+      res = proc_group_leave(th->proc,group);
+    }
+
+  return (res == EXIT_SUCCESS) ? IPC_SUCCESS : IPC_FAILURE;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_group_send(struct thread* th)
+   ----------------------------------------------------
+
+   Send `th` registers message to every member of the group in its destination register
+   (but `th` process), in a single kernel operation. A member gets it through a 
+   receiving thread, or in its mailbox.
+
+   Never blocks, so strict delivery does not wait for members: unless IPC_GROUP_PARTIAL 
+   is set in destination, every member must be ready to get the message, otherwise 
+   nothing is sent and IPC_FAILURE is returned. With IPC_GROUP_PARTIAL, members not 
+   ready are skipped. Number of members reached is returned in first message register,
+   and the sources set of members not reached in the next two, so the caller knows
+   which ones to retry.
+
+   Receivers set ready may preempt `th` at the end of the syscall (see `sched_preempt`).
+
+**/
+
+PRIVATE u8_t syscall_group_send(struct thread* th)
+{
+  struct proc_group* group;
+  struct proc* proc;
+  struct thread* th_receiver;
+  u32_t missed[IPC_SET_WORDS];
+  u32_t dest,i,n;
+
+  dest = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_DEST);
+  group = proc_group(dest & ~(IPC_GROUP|IPC_GROUP_PARTIAL));
+
+  /* Registers only message */
+  if ( (group == NULL) || ( (th->ipc.utcb != NULL) && (th->ipc.utcb->send_len) ) )
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<IPC_SET_WORDS;i++)
+    {
+      missed[i] = 0;
+    }
+
+  /* All or nothing */
+  if (!(dest & IPC_GROUP_PARTIAL))
+    {
+      for(i=0;i<group->count;i++)
+	{
+	  proc = group->members[i];
+	  if ( (proc != th->proc)
+	       && (syscall_find_receiver_async(proc,th->proc) == NULL)
+	       && ( (proc->mailbox == NULL) || (proc->mailbox->count == PROC_MAILBOX_LEN) ) )
+	    {
+	      IPC_SET_ADD(missed,proc->pid);
+	    }
+	}
+
+      if (missed[0] | missed[1])
+	{
+	  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,0);
+	  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG2,missed[0]);
+	  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG3,missed[1]);
+	  return IPC_FAILURE;
+	}
+    }
+
+  n = 0;
+  for(i=0;i<group->count;i++)
+    {
+      proc = group->members[i];
+      if (proc == th->proc)
+	{
+	  continue;
+	}
+
+      th_receiver = syscall_find_receiver_async(proc,th->proc);
+      if (th_receiver != NULL)
+	{
+	  syscall_copymsg(th,th_receiver);
+	  SYSCALL_NOTIFY_SKIP(proc,th->proc->pid);
+
+	  /* End of reception */
+	  syscall_recv_dequeue(th_receiver);
+	  th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
+	  sched_unblock(th_receiver);
+	  n++;
+	}
+      else if ( (proc->mailbox != NULL) && (syscall_mailbox_put(proc,th) == IPC_SUCCESS) )
+	{
+	  n++;
+	}
+      else
+	{
+	  IPC_SET_ADD(missed,proc->pid);
+	}
+    }
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,n);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG2,missed[0]);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG3,missed[1]);
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_user_backed(virtaddr_t addr, u32_t len)
+   --------------------------------------------------------------
+
+   Return IPC_SUCCESS if the `len` bytes at `addr` are user memory backed 
+   in current address space, so kernel can read them without faulting.
+
+**/
+
+PRIVATE u8_t syscall_user_backed(virtaddr_t addr, u32_t len)
+{
+  virtaddr_t page;
+
+  if ( (addr < ARCH_CONST_KERN_HIGHMEM) || (addr + len - 1 < addr) )
+    {
+      return IPC_FAILURE;
+    }
+
+  for(page = addr & ~(ARCH_CONST_PAGE_SIZE-1);
+      page <= addr + len - 1;
+      page += ARCH_CONST_PAGE_SIZE)
+    {
+      if (!arch_tophys(page))
+	{
+	  return IPC_FAILURE;
+	}
+
+      /* Last page of address space */
+      if (page + ARCH_CONST_PAGE_SIZE < page)
+	{
+	  break;
+	}
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: struct proc* syscall_target(struct proc* proc, u32_t dest)
+   --------------------------------------------------------------------
+
+   Resolve destination `dest` given by `proc`: an endpoint handle if
+   IPC_HANDLE flag is set (single table index), a process id otherwise.
+   Return NULL if there is no such destination.
+
+**/
+
+PRIVATE struct proc* syscall_target(struct proc* proc, u32_t dest)
+{
+  if (dest & IPC_HANDLE)
+    {
+      return proc_handle(proc, dest & ~IPC_HANDLE);
+    }
+
+  return proc_pid((pid_t)dest);
+}
+
+
+
+/**
+
+   Function: void syscall_inherit(struct thread* th, struct proc* ptarget)
+   -----------------------------------------------------------------------
+
+   Priority inheritance for `th`, queued sending to `ptarget`.
+
+   Only threads serving the chain are boosted up to `th` priority: in `ptarget`,
+   threads serving a client or queued sending further, then the same in processes 
+   their wait-for edges lead to. Threads blocked in receive will inherit 
+   when they take the message (see `syscall_serve`).
+
+   The walk visits at most SYSCALL_DEADLOCK_DEPTH processes.
+   When `th` leaves the wait list, see `syscall_reinherit_owners`.
+
+**/
+
+PRIVATE void syscall_inherit(struct thread* th, struct proc* ptarget)
+{
+  u32_t budget = SYSCALL_DEADLOCK_DEPTH;
+
+  syscall_inherit_walk(th,ptarget,&budget);
+
+  return;
+}
+
+
+/**
+
+   Function: void syscall_inherit_walk(struct thread* th, struct proc* p, u32_t* budget)
+   -------------------------------------------------------------------------------------
+
+   Boost threads of `p` serving the chain, and follow their wait-for edges,
+   within `budget` visits.
+
+**/
+
+PRIVATE void syscall_inherit_walk(struct thread* th, struct proc* p, u32_t* budget)
+{
+  struct thread_wrapper* wrapper;
+  struct thread* t;
+
+  if ( (*budget == 0) || (p == NULL) || (LLIST_ISNULL(p->thread_list)) )
+    {
+      return;
+    }
+  (*budget)--;
+
+  wrapper = LLIST_GETHEAD(p->thread_list);
+  do
+    {
+      t = wrapper->thread;
+      if ( (t->ipc.client != NULL) || (t->ipc.wait_for != NULL) )
+	{
+	  sched_inherit(t,th->sched.dynamic_prio);
+	  syscall_inherit_walk(th,t->ipc.wait_for,budget);
+	}
+      
+      wrapper = LLIST_NEXT(p->thread_list,wrapper);
+      
+    }while(!LLIST_ISHEAD(p->thread_list,wrapper));
+
+  return;
+}
+
+
+/**
+
+   Function: void syscall_reinherit(struct thread* th)
+   ---------------------------------------------------
+
+   Recompute `th` inherited priority from what it is really serving: its client,
+   and senders queued in its process wait list if it serves the chain 
+   (serving a client or queued sending further).
+
+**/
+
+PRIVATE void syscall_reinherit(struct thread* th)
+{
+  struct thread_wrapper* wrapper;
+
+  sched_disinherit(th);
+
+  if (th->ipc.client != NULL)
+    {
+      sched_inherit(th,th->ipc.client->sched.dynamic_prio);
+    }
+
+  if ( ((th->ipc.client != NULL) || (th->ipc.wait_for != NULL))
+       && (!LLIST_ISNULL(th->proc->wait_list)) )
+    {
+      wrapper = LLIST_GETHEAD(th->proc->wait_list);
+      do
+	{
+	  sched_inherit(th,wrapper->thread->sched.dynamic_prio);
+	  wrapper = LLIST_NEXT(th->proc->wait_list,wrapper);
+	}while(!LLIST_ISHEAD(th->proc->wait_list,wrapper));
+    }
+
+  return;
+}
+
+
+/**
+
+   Function: void syscall_reinherit_owners(struct proc* proc, struct thread* th)
+   -----------------------------------------------------------------------------
+
+   `th` left `proc` wait list (delivery or timeout): recompute the priority of
+   the threads of `proc` serving the chain which may hold it from `th` (their 
+   inherited priority is `th` one). No walk further down the chain: a boost left 
+   there is dropped when those threads are done serving (see `syscall_disinherit`).
+
+**/
+
+PRIVATE void syscall_reinherit_owners(struct proc* proc, struct thread* th)
+{
+  struct thread_wrapper* wrapper;
+  struct thread* t;
+
+  if (LLIST_ISNULL(proc->thread_list))
+    {
+      return;
+    }
+
+  wrapper = LLIST_GETHEAD(proc->thread_list);
+  do
+    {
+      t = wrapper->thread;
+      if ( ((t->ipc.client != NULL) || (t->ipc.wait_for != NULL))
+	   && (t->sched.inherit_prio == th->sched.dynamic_prio) )
+	{
+	  syscall_reinherit(t);
+	}
+      wrapper = LLIST_NEXT(proc->thread_list,wrapper);
+    }while(!LLIST_ISHEAD(proc->thread_list,wrapper));
+
+  return;
+}
+
+
+/**
+
+   Function: void syscall_serve(struct thread* th, struct thread* client)
+   ----------------------------------------------------------------------
+
+   `th` took a synchronous message from `client`, which stays blocked until 
+   our reply or notify: remember it and serve it at its priority.
+
+**/
+
+PRIVATE void syscall_serve(struct thread* th, struct thread* client)
+{
+  th->ipc.client = client;
+  sched_inherit(th,client->sched.dynamic_prio);
+
+  return;
+}
+
+
+/**
+
+   Function: void syscall_disinherit(struct thread* th)
+   ----------------------------------------------------
+
+   `th` is done serving its client: drop inherited priority, 
+   then recompute what is still due (see `syscall_reinherit`).
+
+**/
+
+PRIVATE void syscall_disinherit(struct thread* th)
+{
+  th->ipc.client = NULL;
+  syscall_reinherit(th);
+
+  return;
+}
+
+
+
+/**
+
+   Function: void syscall_rtt(struct thread* th)
+   ---------------------------------------------
+
+   Account the round trip of `th` sendrec, whose reply is being delivered.
+   Every SYSCALL_RTT_ROUNDS round trips, their average is published in
+   `syscall_rtt_cycles` (printed by `syscall_dump`).
+
+**/
+
+PRIVATE void syscall_rtt(struct thread* th)
+{
+  syscall_rtt_sum += arch_cycles() - th->ipc.rtt_start;
+
+  if (++syscall_rtt_count == SYSCALL_RTT_ROUNDS)
+    {
+      syscall_rtt_cycles = syscall_rtt_sum/SYSCALL_RTT_ROUNDS;
+      syscall_rtt_sum = 0;
+      syscall_rtt_count = 0;
+    }
+
+  return;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_deadlock(struct thread* th, struct proc* ptarget)
+   ------------------------------------------------------------------------
+
+   Check for deadlock before `th` blocks sending to `ptarget`.
+
+   Each thread queued sending has a wait-for edge (`ipc.wait_for`) toward the process
+   it is queued on. The send chain is walked from `ptarget`, one hop at a time: a process
+   is blocked if all of its threads (but `th`) are queued sending to the same process, 
+   which is the next hop. Deadlock occurs if the chain gets back to `th` process with no
+   other thread left to take the message.
+   The walk ends with no deadlock as soon as a process has a thread free to receive, 
+   its threads wait for different processes (no single chain), or after 
+   SYSCALL_DEADLOCK_DEPTH hops.
+
+**/
+
+PRIVATE u8_t syscall_deadlock(struct thread* th, struct proc* ptarget)
+{
+  struct thread_wrapper* wrapper;
+  struct thread* t;
+  struct proc* p;
+  struct proc* next;
+  u32_t depth;
+
+  p = ptarget;
+
+  for(depth=0;depth<SYSCALL_DEADLOCK_DEPTH;depth++)
+    {
+      if (LLIST_ISNULL(p->thread_list))
+	{
+	  return IPC_SUCCESS;
+	}
+
+      /* Next hop: where all threads of `p` but `th` are queued sending */
+      next = NULL;
+      wrapper = LLIST_GETHEAD(p->thread_list);
+      do
+	{
+	  t = wrapper->thread;
+	  if (t != th)
+	    {
+	      if ( (t->ipc.wait_for == NULL) || ( (next != NULL) && (t->ipc.wait_for != next) ) )
+		{
+		  return IPC_SUCCESS;
+		}
+	      next = t->ipc.wait_for;
+	    }
+	  wrapper = LLIST_NEXT(p->thread_list,wrapper);
+	}while(!LLIST_ISHEAD(p->thread_list,wrapper));
+
+      /* Back to `th` process, nobody else there to take the message */
+      if (next == NULL)
+	{
+	  syscall_deadlocks++;
+	  return IPC_FAILURE;
+	}
+
+      p = next;
+    }
+  
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: struct thread* syscall_find_receiver(struct proc* ptarget, struct proc* pfrom)
+   --------------------------------------------------------------------------------------
+
+   Return a thread in `ptarget` which is receiving from `pfrom` or from ANY if `pfrom` is NULL
+   Return NULL if such a thread does not exist;
+
+   Threads receiving specifically from `pfrom` are preferred. They are looked up in
+   `pfrom` bucket of `ptarget` receive queues, then threads receiving from a set holding `pfrom`.
+   Otherwise the wildcard queue head is taken.
+
+**/
+   
+
+PRIVATE struct thread* syscall_find_receiver(struct proc* ptarget, struct proc* pfrom)
+{
+
+  struct thread_wrapper* wrapper;
+  u32_t i;
+  
+  /* Look for a thread receiving from `pfrom` */
+  if (pfrom != NULL)
+    {
+      i = PROC_IPC_HASHID(pfrom->pid);
+      if (!LLIST_ISNULL(ptarget->recv_from[i]))
+	{
+	  wrapper=LLIST_GETHEAD(ptarget->recv_from[i]);
+	  do
+	    {
+	      if (wrapper->thread->ipc.recv_from == pfrom)
+		{
+		  return wrapper->thread;
+		}
+	      
+	      wrapper = LLIST_NEXT(ptarget->recv_from[i],wrapper);
+	      
+	    }while(!LLIST_ISHEAD(ptarget->recv_from[i],wrapper));
+	}
+    }
+
+  /* Then a thread receiving from a set holding `pfrom` */
+  if ( (pfrom != NULL) && (!LLIST_ISNULL(ptarget->recv_set)) )
+    {
+      wrapper=LLIST_GETHEAD(ptarget->recv_set);
+      do
+	{
+	  if (IPC_SET_ISIN(wrapper->thread->ipc.recv_set,pfrom->pid))
+	    {
+	      return wrapper->thread;
+	    }
+	      
+	  wrapper = LLIST_NEXT(ptarget->recv_set,wrapper);
+	      
+	}while(!LLIST_ISHEAD(ptarget->recv_set,wrapper));
+    }
+
+  /* Otherwise, any thread receiving from ANY */
+  if (!LLIST_ISNULL(ptarget->recv_any))
+    {
+      wrapper=LLIST_GETHEAD(ptarget->recv_any);
+      return wrapper->thread;
+    }
+
+  return NULL;
+}
+
+
+/**
+
+   Function: struct thread* syscall_find_receiver_async(struct proc* ptarget, struct proc* pfrom)
+   ----------------------------------------------------------------------------------------------
+
+   Like `syscall_find_receiver`, for a message nobody waits a reply to (notification,
+   group send): a thread waiting for the reply to a sendrec is passed over for the 
+   wildcard queue head. Return NULL if no thread can receive it.
+
+**/
+
+
+PRIVATE struct thread* syscall_find_receiver_async(struct proc* ptarget, struct proc* pfrom)
+{
+  struct thread* th;
+  struct thread_wrapper* wrapper;
+
+  th = syscall_find_receiver(ptarget,pfrom);
+  if ( (th != NULL) && (th->ipc.state & SYSCALL_IPC_SENDREC) )
+    {
+      th = NULL;
+      if (!LLIST_ISNULL(ptarget->recv_any))
+	{
+	  wrapper = LLIST_GETHEAD(ptarget->recv_any);
+	  th = wrapper->thread;
+	}
+    }
+
+  return th;
+}
+
+
+
+/**
+
+   Function: struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom, u32_t* set)
+   ----------------------------------------------------------------------------------------------------------
+
+   Return a thread belonging to `pfrom` in `ptarget` wait list.
+   Return NULL if such a thread does not exist;
+
+   If `set` is not NULL, it is a sources set: the oldest sender of the first source in the set 
+   (in bits order, which gives priority) is returned. 
+   If `pfrom` is NULL, the wait list head (oldest sender) is returned.
+   Otherwise the oldest sender from `pfrom` is looked up in its source bucket.
+
+**/
+   
+
+PRIVATE struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom, u32_t* set)
+{
+
+  struct thread_wrapper* wrapper;
+  u32_t i,w,b;
+
+  if (set != NULL)
+    {
+      /* Each set bit maps to a single bucket */
+      for(w=0;w<IPC_SET_WORDS;w++)
+	{
+	  for(b=0;(b<32)&&(set[w]>>b);b++)
+	    {
+	      if (!(set[w] & (1<<b)))
+		{
+		  continue;
+		}
+
+	      i = PROC_IPC_HASHID(w*32+b);
+	      if (!LLIST_ISNULL(ptarget->wait_from[i]))
+		{
+		  wrapper=LLIST_GETHEAD(ptarget->wait_from[i]);
+		  do
+		    {
+		      if (wrapper->thread->proc->pid == w*32+b)
+			{
+			  return wrapper->thread;
+			}
+		      
+		      wrapper = LLIST_NEXT(ptarget->wait_from[i],wrapper);
+		      
+		    }while(!LLIST_ISHEAD(ptarget->wait_from[i],wrapper));
+		}
+	    }
+	}
+
+      return NULL;
+    }
+
+  if (pfrom == NULL)
+    {
+      /* Receive from ANY, return wait list head */
+      if (!LLIST_ISNULL(ptarget->wait_list))
+	{
+	  wrapper=LLIST_GETHEAD(ptarget->wait_list);
+	  return wrapper->thread;
+	}
+
+      return NULL;
+    }
+  
+  /* Look for a thread belonging to `pfrom` in its bucket */
+  i = PROC_IPC_HASHID(pfrom->pid);
+  if (!LLIST_ISNULL(ptarget->wait_from[i]))
+    {
+      wrapper=LLIST_GETHEAD(ptarget->wait_from[i]);
+      do
+	{
+	  if (wrapper->thread->proc == pfrom)
+	    {
+	      return wrapper->thread;
+	    }
+	      
+	  wrapper = LLIST_NEXT(ptarget->wait_from[i],wrapper);
+	  
+	}while(!LLIST_ISHEAD(ptarget->wait_from[i],wrapper));
+    }
+
+  return NULL;
+}
+
+
+/**
+
+   Function: struct thread* syscall_find_blocked_sender(struct proc* ptarget, struct proc* pfrom)
+   ----------------------------------------------------------------------------------------------
+
+   Return a thread belonging to `pfrom` blocked sending to `ptarget`.
+   Return NULL if such a thread does not exist;
+
+**/
+   
+
+PRIVATE struct thread* syscall_find_blocked_sender(struct proc* ptarget, struct proc* pfrom)
+{
+
+  struct thread_wrapper* wrapper;
+
+   /* Check all threads in `ptarget` wait list*/
+  if (!LLIST_ISNULL(pfrom->thread_list))
+    {
+      wrapper=LLIST_GETHEAD(pfrom->thread_list);
+
+      /* look from a thread sending to `ptarget` */
+      do
+	{
+	  if ( (wrapper->thread->ipc.send_to == ptarget)
+	       && (wrapper->thread->state == THREAD_BLOCKED)
+	       && !(wrapper->thread->ipc.state & (SYSCALL_IPC_SENDING|SYSCALL_IPC_RECEIVING)) )
+	    {
+	      return wrapper->thread;
+	    }
+	  
+	  wrapper = LLIST_NEXT(pfrom->thread_list,wrapper);
+	  
+	}while(!LLIST_ISHEAD(pfrom->thread_list,wrapper));
+    }
+
+  return NULL;
+}
+
+
+
+/**
+
+   Function: u8_t syscall_copymsg( struct thread* src, struct thread* dest)
+   ------------------------------------------------------------------------
+   
+   Copy message stored in registers from `src` to `dest`,
+   then message registers if any.
+   
+**/
+
+
+PRIVATE u8_t syscall_copymsg( struct thread* src, struct thread* dest)
+{
+
+  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_SOURCE,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_SOURCE));
+  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG1,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG1));
+  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG2,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG2));
+  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG3,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG3));
+
+  syscall_copymr(src,dest);
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: void syscall_copymr(struct thread* src, struct thread* dest)
+   ----------------------------------------------------------------------
+   
+   Copy the `send_len` message registers of `src` UTCB into `dest` UTCB in one pass,
+   through UTCB kernel aliases. `src` send length is then reset.
+   `dest` receive length is set to the copied length (0 if `src` is NULL or sends 
+   registers only). Registers exceeding `dest` UTCB are lost if it has none.
+   
+**/
+
+
+PRIVATE void syscall_copymr(struct thread* src, struct thread* dest)
+{
+  u32_t len = 0;
+
+  if ( (src != NULL) && (src->ipc.utcb != NULL) && (src->ipc.utcb->send_len) )
+    {
+      len = src->ipc.utcb->send_len;
+      if (len > IPC_UTCB_MR)
+	{
+	  len = IPC_UTCB_MR;
+	}
+      src->ipc.utcb->send_len = 0;
+    }
+
+  if (dest->ipc.utcb != NULL)
+    {
+      if (len)
+	{
+	  arch_memcopy((addr_t)src->ipc.utcb->mr,(addr_t)dest->ipc.utcb->mr,len*sizeof(u32_t));
+	}
+      dest->ipc.utcb->recv_len = len;
+    }
+
+  return;
+}
+
+
+
+/**
+
+   Function: void syscall_recv_enqueue(struct thread* th)
+   ------------------------------------------------------
+
+   Put `th`, blocked in receive, in its process receive queues:
+   the set queue if it receives from a sources set, the wildcard queue 
+   if it receives from ANY, its source bucket otherwise.
+   Must be called once `th` receive source is set.
+
+**/
+
+
+PRIVATE void syscall_recv_enqueue(struct thread* th)
+{
+  struct thread_wrapper* link;
+  u32_t i;
+
+  link = &(th->ipc.recv_link);
+  link->thread = th;
+
+  if (th->ipc.state & SYSCALL_IPC_SET)
+    {
+      LLIST_ADD(th->proc->recv_set,link);
+    }
+  else if (th->ipc.recv_from == NULL)
+    {
+      LLIST_ADD(th->proc->recv_any,link);
+    }
+  else
+    {
+      i = PROC_IPC_HASHID(th->ipc.recv_from->pid);
+      LLIST_ADD(th->proc->recv_from[i],link);
+    }
 
-      /* Unblock sender */
-      th_available->state = THREAD_READY;
+  return;
+}
 
-      /* Set end of sending */
-      th_available->ipc.state &= ~SYSCALL_IPC_SENDING;
 
-      /* Remove sender from receiver waiting list et set it as ready for scheduling */
-      LLIST_REMOVE(th_receiver->proc->wait_list, th_available);
-      sched_enqueue(SCHED_READY_QUEUE, th_available);
 
-      arch_printf("%u unblock  %u from its wait list\n",th_receiver->proc->pid,th_available->proc->pid);
+/**
 
-      /* End of reception */
-      th_receiver->ipc.state &= ~SYSCALL_IPC_RECEIVING;
-      
+   Function: void syscall_recv_dequeue(struct thread* th)
+   ------------------------------------------------------
+
+   Remove `th` from its process receive queues, at the end of reception.
+   Must be called before `th` receive source changes. Disarm `th` timeout if any,
+   and end its receive from a set.
+
+**/
+
+
+PRIVATE void syscall_recv_dequeue(struct thread* th)
+{
+  struct thread_wrapper* link;
+  u32_t i;
+
+  link = &(th->ipc.recv_link);
+
+  if (th->ipc.state & SYSCALL_IPC_SET)
+    {
+      LLIST_REMOVE(th->proc->recv_set,link);
+      th->ipc.state &= ~SYSCALL_IPC_SET;
+    }
+  else if (th->ipc.recv_from == NULL)
+    {
+      LLIST_REMOVE(th->proc->recv_any,link);
     }
   else
     {
-      /* No matching sender found: blocked waiting for a sender */
-      th_receiver->state = THREAD_BLOCKED;
+      i = PROC_IPC_HASHID(th->ipc.recv_from->pid);
+      LLIST_REMOVE(th->proc->recv_from[i],link);
+    }
+
+  /* Wait is over */
+  if (th->ipc.state & SYSCALL_IPC_TIMED)
+    {
+      syscall_timeout_disarm(th);
+    }
 
-      /* Sched queues manipulation */
-      sched_dequeue(SCHED_READY_QUEUE, th_receiver);
-      sched_enqueue(SCHED_BLOCKED_QUEUE, th_receiver);
+  return;
+}
 
-      arch_printf("%u blocked cause no message available\n",th_receiver->proc->pid);
 
-      /* Current thread (receiver) is blocked, need scheduling */
-      struct thread* th;
-      th = sched_elect();
-      
-      /* Change address space */
-      if (th->proc)
-	{
-	  arch_switch_addrspace(th->proc->addrspace);
-	}  
-      
-      thread_switch_to(th);
-      
+
+/**
+
+   Function: void syscall_wait_enqueue(struct proc* proc, struct thread* th)
+   -------------------------------------------------------------------------
+
+   Put `th`, blocked sending to `proc`, at the tail of `proc` wait list
+   and of its source bucket. Set `th` wait-for edge toward `proc`.
+
+**/
+
+
+PRIVATE void syscall_wait_enqueue(struct proc* proc, struct thread* th)
+{
+  struct thread_wrapper* link;
+  u32_t i;
+
+  link = &(th->ipc.wait_link);
+  link->thread = th;
+  LLIST_ADD(proc->wait_list,link);
+
+  link = &(th->ipc.source_link);
+  link->thread = th;
+  i = PROC_IPC_HASHID(th->proc->pid);
+  LLIST_ADD(proc->wait_from[i],link);
+
+  /* Wait-for graph edge */
+  th->ipc.wait_for = proc;
+
+  return;
+}
+
+
+
+/**
+
+   Function: void syscall_wait_dequeue(struct proc* proc, struct thread* th)
+   -------------------------------------------------------------------------
+
+   Remove `th` from `proc` wait list and source bucket.
+   Clear `th` wait-for edge and recompute priorities it was lending along the chain.
+   Disarm `th` timeout if any.
+
+**/
+
+
+PRIVATE void syscall_wait_dequeue(struct proc* proc, struct thread* th)
+{
+  struct thread_wrapper* link;
+  u32_t i;
+
+  link = &(th->ipc.wait_link);
+  LLIST_REMOVE(proc->wait_list,link);
+
+  link = &(th->ipc.source_link);
+  i = PROC_IPC_HASHID(th->proc->pid);
+  LLIST_REMOVE(proc->wait_from[i],link);
+
+  /* Wait-for graph edge */
+  th->ipc.wait_for = NULL;
+
+  /* Owners boosted by `th` no longer inherit from it */
+  syscall_reinherit_owners(proc,th);
+
+  /* Wait is over */
+  if (th->ipc.state & SYSCALL_IPC_TIMED)
+    {
+      syscall_timeout_disarm(th);
     }
-  
-  return IPC_SUCCESS;
+
+  return;
 }
 
 
+
 /**
 
-   u8_t syscall_notify(struct thread* th_from, struct thread* th_to)
-   -----------------------------------------------------------------
+   Function: u8_t syscall_notify_pending(struct proc* proc, struct proc* pfrom, u32_t* set)
+   ----------------------------------------------------------------------------------------
 
-   Send a notification from `th_from` to `th_to`
-   This syscall is used by receiver to notify blocked sender that message processing is finished.
-   Simply change `th_to` state to ready for scheduling
+   Return TRUE if `proc` has a pending notification from `pfrom`, from a source in `set`
+   if `set` is not NULL, or any pending notification if both are NULL. FALSE otherwise.
 
 **/
 
-PRIVATE u8_t syscall_notify(struct thread* th_from, struct proc* proc_to)
+
+PRIVATE u8_t syscall_notify_pending(struct proc* proc, struct proc* pfrom, u32_t* set)
 {
-  struct thread* th;
+  u32_t i;
 
-  th = syscall_find_blocked_sender(th_from->proc,proc_to);
-  if (th != NULL)
+  if (set != NULL)
     {
-      arch_printf("%u unblocks %u via notify\n",th_from->proc->pid,proc_to->pid);
-      
-      /* Set recipient ready for scheduling */
-      th->state = THREAD_READY;
-      /* End of sending */
-      th->ipc.state &= ~SYSCALL_IPC_SENDING;
+      for(i=0;i<PROC_NOTIFY_WORDS;i++)
+	{
+	  if (proc->notify_pending[i] & set[i])
+	    {
+	      return TRUE;
+	    }
+	}
       
-      /* Scheduler queues manipulation */
-      sched_dequeue(SCHED_BLOCKED_QUEUE,th);
-      sched_enqueue(SCHED_READY_QUEUE,th);
+      return FALSE;
+    }
 
-      return IPC_SUCCESS;
+  if (pfrom != NULL)
+    {
+      return (proc->notify_pending[SYSCALL_NOTIFY_WORD(pfrom->pid)] & SYSCALL_NOTIFY_BIT(pfrom->pid)) ? TRUE : FALSE;
     }
 
-  //arch_printf("Notify failed\n");
+  for(i=0;i<PROC_NOTIFY_WORDS;i++)
+    {
+      if (proc->notify_pending[i])
+	{
+	  return TRUE;
+	}
+    }
 
-  //return IPC_FAILURE;
-  return IPC_SUCCESS;
+  return FALSE;
 }
 
 
 
 /**
 
-   Function: u8_t syscall_deadlock(struct proc* psender, struct proc* ptarget)
-   ---------------------------------------------------------------------------
+   Function: void syscall_notify_deliver(struct thread* th)
+   --------------------------------------------------------
 
-   Check for deadlock during send
-
-   Simply follow the "send chain" to check if a loop occurs.
-   This function is a DFS-like recursive function.
+   Deliver `th` process pending notifications to `th` as a message from IPC_NOTIFICATION.
+   The bitmap is copied in message registers then cleared. If `th` receives from 
+   a sources set, only notifications from the set are delivered and cleared.
 
 **/
 
-PRIVATE u8_t syscall_deadlock(struct proc* psender, struct proc* ptarget)
+
+PRIVATE void syscall_notify_deliver(struct thread* th)
 {
+  struct proc* proc = th->proc;
+  u32_t mask[PROC_NOTIFY_WORDS];
+  u32_t i;
 
-  struct thread_wrapper* wrapper;
-  
-  /* Check all threads in `ptarget`*/
-  if (!LLIST_ISNULL(ptarget->thread_list))
+  for(i=0;i<PROC_NOTIFY_WORDS;i++)
     {
-      wrapper=LLIST_GETHEAD(ptarget->thread_list);
-      do
-	{
-	  /* A thread is sending */
-	  if (wrapper->thread->ipc.state == SYSCALL_IPC_SENDING)
-	    {
-	      /* Does it send to sender ? */
-	      if (wrapper->thread->ipc.send_to == psender)
-		{
-		  /* If yes, return Failure */
-		  return IPC_FAILURE;
-		}
-	      else
-		{
-		  /* Otherwise, check that new "send chain" */
-		  if (syscall_deadlock(psender,wrapper->thread->ipc.send_to) == IPC_FAILURE)
-		    {
-		      return IPC_FAILURE;
-		    }
-		}
-	    }
-	  
-	  wrapper = LLIST_NEXT(ptarget->thread_list,wrapper);
-	  
-	}while(!LLIST_ISHEAD(ptarget->thread_list,wrapper));
+      mask[i] = (th->ipc.state & SYSCALL_IPC_SET) ? th->ipc.recv_set[i] : 0xFFFFFFFF;
     }
-  
-  return IPC_SUCCESS;
+
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_SOURCE,IPC_NOTIFICATION);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,proc->notify_pending[0] & mask[0]);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG2,proc->notify_pending[1] & mask[1]);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG3,0);
+  syscall_copymr(NULL,th);
+
+  proc->notify_pending[0] &= ~mask[0];
+  proc->notify_pending[1] &= ~mask[1];
+
+  return;
 }
 
 
+
 /**
 
-   Function: struct thread* syscall_find_receiver(struct proc* ptarget, struct proc* pfrom)
-   --------------------------------------------------------------------------------------
+   Function: u8_t syscall_mailbox_put(struct proc* proc, struct thread* th)
+   ------------------------------------------------------------------------
 
-   Return a thread in `ptarget` which is receiving from `pfrom` or from ANY if `pfrom` is NULL
-   Return NULL if such a thread does not exist;
+   Store `th` message at the tail of `proc` mailbox.
+   Return IPC_FAILURE if `proc` has no mailbox, if it is full, or if message has message registers
+   (they are only delivered by rendezvous).
 
 **/
-   
 
-PRIVATE struct thread* syscall_find_receiver(struct proc* ptarget, struct proc* pfrom)
+
+PRIVATE u8_t syscall_mailbox_put(struct proc* proc, struct thread* th)
 {
+  u32_t data[3];
 
-  struct thread_wrapper* wrapper;
-  
-  /* Check all threads in `ptarget`*/
-  if (!LLIST_ISNULL(ptarget->thread_list))
+  if ( (th->ipc.utcb != NULL) && (th->ipc.utcb->send_len) )
     {
-      wrapper=LLIST_GETHEAD(ptarget->thread_list);
-      do
-	{
-	  /* A thread is receiving from `pfrom` - works even if `pfrom` is NULL */
-	  if ( (wrapper->thread->ipc.state == SYSCALL_IPC_RECEIVING)
-	       && ((wrapper->thread->ipc.recv_from == pfrom) || (wrapper->thread->ipc.recv_from == NULL)) )
-	    {
-	      /* Return thread */
-	      return wrapper->thread;
-	    }
-	  
-	  wrapper = LLIST_NEXT(ptarget->thread_list,wrapper);
-	  
-	}while(!LLIST_ISHEAD(ptarget->thread_list,wrapper));
+      return IPC_FAILURE;
     }
 
-  return NULL;
+  data[0] = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG1);
+  data[1] = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG2);
+  data[2] = arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_MSG3);
+
+  return syscall_mailbox_post(proc,arch_ctx_get((arch_ctx_t*)th,ARCH_CONST_SOURCE),data);
 }
 
 
+
 /**
 
-   Function: struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom)
-   ----------------------------------------------------------------------------------------------
+   Function: u8_t syscall_mailbox_post(struct proc* proc, pid_t from, u32_t* data)
+   -------------------------------------------------------------------------------
 
-   Return a thread belonging to `pfrom` in `ptarget` wait list.
-   Return NULL if such a thread does not exist;
+   Store the 3 words message `data` from `from` at the tail of `proc` mailbox.
+   Return IPC_FAILURE if `proc` has no mailbox or if it is full.
 
 **/
-   
 
-PRIVATE struct thread* syscall_find_waiting_sender(struct proc* ptarget, struct proc* pfrom)
+
+PRIVATE u8_t syscall_mailbox_post(struct proc* proc, pid_t from, u32_t* data)
 {
+  struct proc_mailbox* mailbox = proc->mailbox;
+  u32_t i;
+
+  if ( (mailbox == NULL) || (mailbox->count == PROC_MAILBOX_LEN) )
+    {
+      return IPC_FAILURE;
+    }
+
+  i = (mailbox->head + mailbox->count)%PROC_MAILBOX_LEN;
+  mailbox->msg[i].from = from;
+  mailbox->msg[i].data[0] = data[0];
+  mailbox->msg[i].data[1] = data[1];
+  mailbox->msg[i].data[2] = data[2];
+  mailbox->count++;
+
+  return IPC_SUCCESS;
+}
+
 
-  struct thread* th;
 
-  /* Check all threads in `ptarget` wait list*/
-  if (!LLIST_ISNULL(ptarget->wait_list))
+/**
+
+   Function: u8_t syscall_mailbox_get(struct thread* th, struct proc* pfrom)
+   -------------------------------------------------------------------------
+
+   Copy to `th` the oldest message from `pfrom` (or from ANY if `pfrom` is NULL,
+   or from a source in `th` sources set) in `th` process mailbox, and remove it. Following messages are shifted to keep order.
+   Return IPC_FAILURE if there is no such message.
+
+**/
+
+
+PRIVATE u8_t syscall_mailbox_get(struct thread* th, struct proc* pfrom)
+{
+  struct proc_mailbox* mailbox = th->proc->mailbox;
+  u32_t i,j,k;
+
+  if ( (mailbox == NULL) || (mailbox->count == 0) )
     {
-      th=LLIST_GETHEAD(ptarget->wait_list);
+      return IPC_FAILURE;
+    }
 
-      if (pfrom == NULL)
+  /* Look for the message */
+  for(k=0;k<mailbox->count;k++)
+    {
+      i = (mailbox->head + k)%PROC_MAILBOX_LEN;
+      if ( (th->ipc.state & SYSCALL_IPC_SET) 
+	   ? IPC_SET_ISIN(th->ipc.recv_set,mailbox->msg[i].from)
+	   : ( (pfrom == NULL) || (mailbox->msg[i].from == pfrom->pid) ) )
 	{
-	  /* Receive from ANY, return wait list head */
-	  return th;
+	  break;
 	}
-      else
+    }
+
+  if (k == mailbox->count)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Copy it */
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_SOURCE,mailbox->msg[i].from);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG1,mailbox->msg[i].data[0]);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG2,mailbox->msg[i].data[1]);
+  arch_ctx_set((arch_ctx_t*)th,ARCH_CONST_MSG3,mailbox->msg[i].data[2]);
+  syscall_copymr(NULL,th);
+
+  /* Sender did not wait: no notify */
+  SYSCALL_NOTIFY_SKIP(th->proc,mailbox->msg[i].from);
+
+  if (k == 0)
+    {
+      /* Oldest one: simply advance head */
+      mailbox->head = (mailbox->head + 1)%PROC_MAILBOX_LEN;
+    }
+  else
+    {
+      /* Shift following messages */
+      for(;k<mailbox->count-1;k++)
 	{
-	  /* look from a thread belonging to `pfrom` */
-	  do
-	    {
-	      if (th->proc == pfrom)
-		{
-		  return th;
-		}
-	      
-	      th = LLIST_NEXT(ptarget->wait_list,th);
-	  
-	    }while(!LLIST_ISHEAD(ptarget->wait_list,th));
+	  i = (mailbox->head + k)%PROC_MAILBOX_LEN;
+	  j = (i + 1)%PROC_MAILBOX_LEN;
+	  mailbox->msg[i] = mailbox->msg[j];
 	}
     }
+  mailbox->count--;
 
-  return NULL;
+  return IPC_SUCCESS;
 }
 
 
+
 /**
 
-   Function: struct thread* syscall_find_blocked_sender(struct proc* ptarget, struct proc* pfrom)
-   ----------------------------------------------------------------------------------------------
+   Function: void syscall_timeout_arm(struct thread* th)
+   -----------------------------------------------------
 
-   Return a thread belonging to `pfrom` blocked sending to `ptarget`.
-   Return NULL if such a thread does not exist;
+   Turn `th` relative timeout into a deadline and put `th` in timeouts list
 
 **/
-   
 
-PRIVATE struct thread* syscall_find_blocked_sender(struct proc* ptarget, struct proc* pfrom)
+
+PRIVATE void syscall_timeout_arm(struct thread* th)
 {
+  struct thread_wrapper* link;
 
-  struct thread_wrapper* wrapper;
+  th->ipc.deadline += clock_get_ticks();
 
-   /* Check all threads in `ptarget` wait list*/
-  if (!LLIST_ISNULL(pfrom->thread_list))
-    {
-      wrapper=LLIST_GETHEAD(pfrom->thread_list);
+  link = &(th->ipc.timeout_link);
+  link->thread = th;
+  LLIST_ADD(syscall_timeouts,link);
 
-      /* look from a thread sending to `ptarget` */
-      do
-	{
-	  if ( (wrapper->thread->ipc.send_to == ptarget)
-	       && (wrapper->thread->state == THREAD_BLOCKED)
-	       && (wrapper->thread->ipc.state != SYSCALL_IPC_RECEIVING) )
-	    {
-	      return wrapper->thread;
-	    }
-	  
-	  wrapper = LLIST_NEXT(pfrom->thread_list,wrapper);
-	  
-	}while(!LLIST_ISHEAD(pfrom->thread_list,wrapper));
-    }
+  return;
+}
 
-  return NULL;
+
+
+/**
+
+   Function: void syscall_timeout_disarm(struct thread* th)
+   --------------------------------------------------------
+
+   Remove `th` from timeouts list and end its timed IPC
+
+**/
+
+
+PRIVATE void syscall_timeout_disarm(struct thread* th)
+{
+  struct thread_wrapper* link;
+
+  link = &(th->ipc.timeout_link);
+  LLIST_REMOVE(syscall_timeouts,link);
+
+  th->ipc.state &= ~SYSCALL_IPC_TIMED;
+
+  return;
 }
 
 
 
 /**
 
-   Function: u8_t syscall_copymsg( struct thread* src, struct thread* dest)
-   ------------------------------------------------------------------------
-   
-   Copy message stored in registers from `src` to `dest`.
-   
+   Function: void syscall_switch(struct thread* th)
+   ------------------------------------------------
+
+   Switch from a thread blocked in IPC to `th` (handoff).
+   If `th` is NULL, handoff is disabled or a ready thread has a higher priority than `th`,
+   switch to the thread elected by scheduler instead: handoff never delays a higher priority thread.
+
+   On handoff, `th` runs on what is left of the blocked thread quantum (timeslice donation).
+   `th` stays in the ready queue, so it simply runs until the next scheduling.
+
 **/
 
 
-PRIVATE u8_t syscall_copymsg( struct thread* src, struct thread* dest)
+PRIVATE void syscall_switch(struct thread* th)
 {
+  if ( (th == NULL) || (!SYSCALL_HANDOFF) || (sched_outranked(th)) )
+    {
+      th = sched_elect();
+    }
+  else
+    {
+      sched_donate(cur_th,th);
+    }
 
-  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_SOURCE,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_SOURCE));
-  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG1,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG1));
-  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG2,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG2));
-  arch_ctx_set((arch_ctx_t*)dest,ARCH_CONST_MSG3,arch_ctx_get((arch_ctx_t*)src,ARCH_CONST_MSG3));
+  sched_switch(th,TRUE);
 
-  return EXIT_SUCCESS;
+  return;
 }
@@ -18,11 +18,15 @@
 
    - define.h
    - types.h
+   - arch_ctx.h : cpu context
+   - thread.h   : struct thread
 
 **/
 
 #include <define.h>
 #include <types.h>
+#include <arch_ctx.h>
+#include "thread.h"
 
 
 /**
@@ -30,10 +34,15 @@
    Prototypes
    ----------
 
-   Give access to the syscall handler
+   Give access to the syscall handler, its fast path, IPC timeouts expiry and next deadline, IPC statistics dump and IPC cleanup of a dying thread
 
 **/
 
 PUBLIC void syscall_handle();
+PUBLIC arch_ctx_t* syscall_fastpath(u32_t syscall_num, u32_t dest);
+PUBLIC void syscall_expire(u32_t now);
+PUBLIC u32_t syscall_next_timeout(u32_t now);
+PUBLIC void syscall_dump(void);
+PUBLIC void syscall_cancel(struct thread* th);
 
 #endif
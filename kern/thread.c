@@ -20,8 +20,11 @@
    - arch_io.h
    - arch_const : architecture dependent constants
    - arch_ctx.h : CPU context
+   - arch_vm.h  : UTCB mapping
+   - pager0.h   : UTCB page and kernel alias
    - vm_slab.h  : slab allocator
    - sched.h    : scheduler
+   - syscall.h  : IPC cleanup
    - thread.h   : self header
 
 **/
@@ -33,8 +36,11 @@
 #include <arch_io.h>
 #include <arch_const.h>
 #include <arch_ctx.h>
+#include <arch_vm.h>
+#include "pager0.h"
 #include "vm_slab.h"
 #include "sched.h"
+#include "syscall.h"
 #include "thread.h"
 
 
@@ -64,6 +70,20 @@ struct vm_cache* thread_cache;
 struct thread ksetup_th;
 
 
+
+/**
+
+   Privates
+   --------
+
+   UTCB page release
+
+**/
+
+
+PRIVATE u8_t thread_utcb_release(struct thread* th);
+
+
 /**
 
    Function: u8_t thread_setup(void)
@@ -94,6 +114,9 @@ PUBLIC u8_t thread_setup(void)
   ksetup_th.name[8] = 0;
 
   
+  /* Default scheduling parameters */
+  sched_init(&ksetup_th);
+
   /* Define it as current thread */
   ksetup_th.state = THREAD_READY;
   sched_enqueue(SCHED_READY_QUEUE,&ksetup_th);
@@ -170,6 +193,9 @@ PUBLIC struct thread* thread_create(const char* name, virtaddr_t base, virtaddr_
       goto err;
     }
 
+  /* Default scheduling parameters */
+  sched_init(th);
+
   /* Link in scheduler */
   th->state = THREAD_READY;
   sched_enqueue(SCHED_READY_QUEUE,th);
@@ -195,7 +221,8 @@ PUBLIC struct thread* thread_create(const char* name, virtaddr_t base, virtaddr_
 
    Destroy a thread
    
-   Unlink from scheduler then return thread structure to cache
+   Unlink from scheduler and IPC queues, release UTCB page 
+   then return thread structure to cache
 
 **/
 
@@ -232,7 +259,8 @@ PUBLIC  u8_t thread_destroy(struct thread* th)
     case THREAD_BLOCKED:
     case THREAD_BLOCKED_SENDING:
       {
-	res = sched_dequeue(SCHED_BLOCKED_QUEUE,th);
+	/* May still be in ready queue (lazy scheduling) */
+	res = sched_dequeue(th->sched.queue,th);
 	break;
       }
 
@@ -256,6 +284,18 @@ PUBLIC  u8_t thread_destroy(struct thread* th)
       return EXIT_FAILURE;
     }
 
+  /* Leave IPC queues and timeouts */
+  syscall_cancel(th);
+
+  /* Release UTCB page */
+  if (th->ipc.utcb != NULL)
+    {
+      if (thread_utcb_release(th) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
   /* Return to cache */
   res = vm_cache_free(thread_cache,th);
   
@@ -264,6 +304,131 @@ PUBLIC  u8_t thread_destroy(struct thread* th)
 
 
 
+/**
+
+   Function: u8_t thread_utcb(struct thread* th)
+   ---------------------------------------------
+
+   Create `th` UTCB page. Must be called in `th` address space.
+
+   The user page is taken in UTCB area and backed by a page from pager0,
+   without any page fault. That page is also mapped in kernel space, so IPC 
+   can copy message registers between threads whatever the current address 
+   space is, and it is cleared through this alias.
+   Succeed if `th` already has an UTCB.
+
+**/
+
+
+PUBLIC u8_t thread_utcb(struct thread* th)
+{
+  virtaddr_t uaddr,kaddr;
+  physaddr_t paddr;
+
+  /* Sanity checks */
+  if ( (th == NULL) || (th->proc == NULL) || (th->proc->addrspace != arch_get_addrspace()) )
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (th->ipc.utcb != NULL)
+    {
+      return EXIT_SUCCESS;
+    }
+
+  if (th->proc->utcb_seed >= THREAD_UTCB_MAX)
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* Back user page explicitly */
+  uaddr = THREAD_UTCB_BASE + th->proc->utcb_seed*ARCH_CONST_PAGE_SIZE;
+  paddr = pager0_alloc();
+  if (paddr == PAGER0_ERROR)
+    {
+      return EXIT_FAILURE;
+    }
+
+  if (pager0_user_map(uaddr,paddr) != EXIT_SUCCESS)
+    {
+      pager0_free(paddr);
+      return EXIT_FAILURE;
+    }
+
+  /* Kernel alias */
+  kaddr = pager0_alias(paddr);
+  if (kaddr == PAGER0_ERROR)
+    {
+      arch_user_unmap(uaddr);
+      pager0_free(paddr);
+      return EXIT_FAILURE;
+    }
+
+  arch_memset(0,kaddr,ARCH_CONST_PAGE_SIZE);
+
+  th->proc->utcb_seed++;
+  th->ipc.utcb = (struct ipc_utcb*)kaddr;
+  th->ipc.utcb_user = uaddr;
+
+  return EXIT_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t thread_utcb_release(struct thread* th)
+   -----------------------------------------------------
+
+   Release `th` UTCB page: remove its user mapping in `th` address space
+   and its kernel alias, then give the page back to pager0.
+
+**/
+
+
+PRIVATE u8_t thread_utcb_release(struct thread* th)
+{
+  virtaddr_t cur_addrspace;
+  physaddr_t paddr;
+
+  /* Kernel alias is mapped in every address space */
+  paddr = arch_tophys((virtaddr_t)th->ipc.utcb);
+  if (!paddr)
+    {
+      return EXIT_FAILURE;
+    }
+
+  /* User mapping, in `th` address space */
+  cur_addrspace = arch_get_addrspace();
+  if (th->proc->addrspace != cur_addrspace)
+    {
+      if (arch_switch_addrspace(th->proc->addrspace) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
+  arch_user_unmap(th->ipc.utcb_user);
+
+  if (th->proc->addrspace != cur_addrspace)
+    {
+      if (arch_switch_addrspace(cur_addrspace) != EXIT_SUCCESS)
+	{
+	  return EXIT_FAILURE;
+	}
+    }
+
+  pager0_unalias((virtaddr_t)th->ipc.utcb);
+  pager0_free(paddr);
+
+  th->ipc.utcb = NULL;
+  th->ipc.utcb_user = 0;
+
+  return EXIT_SUCCESS;
+}
+
+
+
 /**
 
    Function: u8_t thread_switch_to(struct thread* th)
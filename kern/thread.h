@@ -18,6 +18,7 @@
    - define.h
    - types.h
    - llist.h
+   - ipc.h      : sources sets size
    - arch_ctx.h : CPU context 
    - proc.h     : struct proc needed
 
@@ -27,6 +28,7 @@
 #include <define.h>
 #include <types.h>
 #include <llist.h>
+#include <ipc.h>
 #include <arch_ctx.h>
 #include "proc.h"
 
@@ -42,6 +44,20 @@
 #define THREAD_NAMELEN               32
 
 
+/**
+   
+   Constants: UTCB area
+   --------------------
+
+   User virtual area where threads UTCB pages are mapped (one page per thread)
+
+**/
+
+
+#define THREAD_UTCB_BASE             0xA0000000
+#define THREAD_UTCB_MAX              1024
+
+
 /**
  
    Enum: enum state
@@ -77,10 +93,14 @@ PUBLIC enum state
    Aggregate scheduler relatives. Member are:
 
    - static_prio     : defined priority
-   - dynamic_prio    : moving priority
-   - head_prio       : start priority in staircase scheduler
-   - static_quantum  : defined quantum
-   - dynamic_quantum : moving quantum
+   - dynamic_prio    : moving priority (effective one, including inherited priority)
+   - head_prio       : start priority in staircase scheduler (top step)
+   - inherit_prio    : highest inherited priority (SCHED_PRIO_LEVELS if none), 
+                       the staircase never steps below it
+   - static_quantum  : defined quantum (ticks per step)
+   - dynamic_quantum : moving quantum (ticks left at current step)
+   - queue           : scheduler queue the thread is linked in (it can differ from 
+                       its state with lazy scheduling, see `sched_block`)
 
 **/
 
@@ -89,8 +109,30 @@ PUBLIC struct sched
   u8_t static_prio;
   u8_t dynamic_prio;
   s8_t head_prio;
+  u8_t inherit_prio;
   u8_t static_quantum;
   s8_t dynamic_quantum;
+  u8_t queue;
+};
+
+
+
+/**
+   
+   Structure: struct thread_wrapper
+   --------------------------------
+
+   Wrap a thread into a linked list
+   Members are self explanatory
+
+**/
+
+
+struct thread_wrapper
+{
+  struct thread* thread;
+  struct thread_wrapper* prev;
+  struct thread_wrapper* next;
 };
 
 
@@ -101,6 +143,17 @@ PUBLIC struct sched
    ---------------------
 
    Contains IPC relatives.
+   `recv_link` links the thread in its process receive queues while blocked in receive.
+   `wait_link` and `source_link` link the thread in the receiver process wait queues
+   (FIFO and per source) while blocked waiting for a receiver.
+   `utcb` is the kernel alias of the thread UTCB page, mapped at `utcb_user` in user space.
+   `recv_set` is the sources set of a receive from a set.
+   `deadline` is the timed IPC timeout (relative when requested, absolute tick once armed), 
+   `timeout_link` links the thread in armed timeouts list.
+   `wait_for` is the wait-for graph edge: process the thread is queued sending to (NULL if none).
+   `client` is the thread served synchronously (blocked until our reply or notify), whose 
+   priority is inherited (NULL if none).
+   `rtt_start` is the cycle count when the pending sendrec started (round trip measure).
 
 **/
 
@@ -110,6 +163,17 @@ PUBLIC struct ipc
   u8_t state;
   struct proc* send_to;
   struct proc* recv_from;
+  struct thread_wrapper recv_link;
+  struct thread_wrapper wait_link;
+  struct thread_wrapper source_link;
+  struct ipc_utcb* utcb;
+  virtaddr_t utcb_user;
+  u32_t recv_set[IPC_SET_WORDS];
+  u32_t deadline;
+  struct thread_wrapper timeout_link;
+  struct proc* wait_for;
+  struct thread* client;
+  u32_t rtt_start;
 };
 
 
@@ -130,11 +194,14 @@ PUBLIC struct ipc
   - state      : scheduling state
   - next_state : future state for scheduler decision
   - nice       : nice level (priority)
-  - sched      : scheduler info
   - ipc        : IPC info
+  - sched      : scheduler info
   - prev       : previous thread in linked list
   - next       : next thread in linked list
 
+  Structure is packed but kept 4 bytes aligned, as IPC links are embedded in it
+  (so `ipc` is kept before byte sized members).
+
 **/
 
 PUBLIC struct thread
@@ -148,11 +215,11 @@ PUBLIC struct thread
   enum state state;
   //enum state next_state;
   //s8_t nice;
-  //struct sched sched;
   struct ipc ipc;
+  struct sched sched;
   struct thread* prev;
   struct thread* next;
-}__attribute__ ((packed));
+}__attribute__ ((packed,aligned(4)));
 
 
 
@@ -174,7 +241,7 @@ PUBLIC struct thread* cur_th;
    Prototypes
    ----------
 
-   Give access to thread setup, creation and switch.
+   Give access to thread setup, creation, UTCB creation and switch.
 
 **/
 
@@ -183,5 +250,6 @@ PUBLIC u8_t thread_setup(void);
 PUBLIC struct thread* thread_create(const char* name, virtaddr_t base, virtaddr_t stack_base, size_t stack_size);
 PUBLIC u8_t thread_destroy(struct thread* th);
 PUBLIC u8_t thread_switch_to(struct thread* th);
+PUBLIC u8_t thread_utcb(struct thread* th);
 
 #endif
@@ -0,0 +1,135 @@
+/**
+
+   channel.c
+   =========
+
+   Channels records transfer.
+
+   Records go through the shared ring without entering kernel.
+   Peer is notified (`ipc_notify`) only when the ring goes from empty 
+   to not empty (consumer) or from full to not full (producer), so
+   a side finding the ring empty (or full) can wait for it with `ipc_receive`.
+
+**/
+
+
+/**
+
+   Includes
+   --------
+
+   - define.h
+   - types.h
+   - ipc.h     : self header
+
+**/
+
+
+#include <define.h>
+#include <types.h>
+#include <ipc.h>
+
+
+
+/**
+
+   Macros: CHANNEL_BARRIER, CHANNEL_FENCE
+   --------------------------------------
+
+   Compiler barrier, ordering records and counter accesses (x86 keeps stores in order),
+   and full memory fence, ordering our counter store before reading peer counter.
+   Without the fence, both sides could miss each other update and nobody would notify.
+
+**/
+
+
+#define CHANNEL_BARRIER()					\
+  __asm__ __volatile__ ("" ::: "memory")
+
+#define CHANNEL_FENCE()						\
+  __asm__ __volatile__ ("lock; addl $0,(%%esp)" ::: "memory")
+
+
+
+/**
+
+   Function: u8_t ipc_channel_put(struct ipc_channel* ch, u32_t* rec)
+   ------------------------------------------------------------------
+
+   Write record `rec` in channel `ch` (producer side).
+   Return IPC_FAILURE if the ring is full.
+
+**/
+
+
+PUBLIC u8_t ipc_channel_put(struct ipc_channel* ch, u32_t* rec)
+{
+  u32_t tail,i;
+
+  tail = ch->tail;
+  if (tail - ch->head == ch->size)
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<IPC_CHANNEL_REC;i++)
+    {
+      ch->rec[tail & (ch->size-1)][i] = rec[i];
+    }
+
+  /* Publish record */
+  CHANNEL_BARRIER();
+  ch->tail = tail+1;
+  CHANNEL_FENCE();
+
+  /* Ring was empty: wake up consumer */
+  if (ch->head == tail)
+    {
+      ipc_notify(ch->consumer);
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t ipc_channel_get(struct ipc_channel* ch, u32_t* rec)
+   ------------------------------------------------------------------
+
+   Read the oldest record of channel `ch` in `rec` (consumer side).
+   Return IPC_FAILURE if the ring is empty.
+
+**/
+
+
+PUBLIC u8_t ipc_channel_get(struct ipc_channel* ch, u32_t* rec)
+{
+  u32_t head,i;
+
+  head = ch->head;
+  if (ch->tail == head)
+    {
+      return IPC_FAILURE;
+    }
+
+  CHANNEL_BARRIER();
+  for(i=0;i<IPC_CHANNEL_REC;i++)
+    {
+      rec[i] = ch->rec[head & (ch->size-1)][i];
+    }
+
+  /* Release slot */
+  CHANNEL_BARRIER();
+  ch->head = head+1;
+  CHANNEL_FENCE();
+
+  /* Ring was full: wake up producer */
+  if (ch->tail - head == ch->size)
+    {
+      ipc_notify(ch->producer);
+    }
+
+  return IPC_SUCCESS;
+}
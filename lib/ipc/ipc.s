@@ -24,6 +24,20 @@ global	ipc_send
 global	ipc_receive
 global	ipc_notify
 global	ipc_sendrec
+global	ipc_reply_receive
+global	ipc_mailbox
+global	ipc_utcb
+global	ipc_map
+global	ipc_send_timeout
+global	ipc_receive_timeout
+global	ipc_receive_set
+global	ipc_handle
+global	ipc_handle_close
+global	ipc_send_batch
+global	ipc_channel
+global	ipc_group
+global	ipc_group_send
+global	ipc_window
 	
 	
 	;;/**
@@ -40,7 +54,65 @@ IPC_SYSCALL_VECTOR	equ	50
 IPC_SEND_NUM		equ	1
 IPC_RECEIVE_NUM		equ	2
 IPC_NOTIFY_NUM		equ	3
+IPC_SENDREC_NUM		equ	4
+IPC_REPLY_RECEIVE_NUM	equ	5
+IPC_MAILBOX_NUM		equ	6
+IPC_UTCB_NUM		equ	7
+IPC_MAP_NUM		equ	8
+IPC_SEND_TIMEOUT_NUM	equ	9
+IPC_RECEIVE_TIMEOUT_NUM	equ	10
+IPC_RECEIVE_SET_NUM	equ	11
+IPC_HANDLE_NUM		equ	12
+IPC_HANDLE_CLOSE_NUM	equ	13
+IPC_SEND_BATCH_NUM	equ	14
+IPC_CHANNEL_NUM		equ	15
+IPC_GROUP_NUM		equ	16
+IPC_GROUP_SEND_NUM	equ	17
+IPC_WINDOW_NUM		equ	18
+IPC_GROUP		equ	0x40000000
+IPC_GROUP_PARTIAL	equ	0x20000000
+IPC_TIMEOUT_SHIFT	equ	8
 IPC_SUCCESS		equ	0
+
+
+	;;/**
+	;; 
+	;; 	Macro: ipc_trap
+	;; 	---------------
+	;;
+	;; 	Enter kernel. Default is `int IPC_SYSCALL_VECTOR`.
+	;;
+	;; 	If IPC_SYSENTER is defined (ipc_sysenter.o variant), SYSENTER is used instead.
+	;; 	EAX does not carry a value in: it holds the iretd return address, and the
+	;; 	stack is passed in EBP (saved on stack). On top of that stack, 3 slots are
+	;; 	left for kernel: ECX and EDX results, then the SYSEXIT return address.
+	;;
+	;; 	Kernel returns through SYSEXIT if the caller did not block, which clobbers
+	;; 	ECX and EDX: they are reloaded from the slots. Otherwise it returns 
+	;; 	through iretd, with message registers intact, past the reload.
+	;;
+	;;**/
+
+	
+%macro	ipc_trap 0
+%ifdef IPC_SYSENTER
+	push	ebp
+	push	%%fast
+	push	edx
+	push	ecx
+	mov	ebp,esp
+	mov	eax,%%ret
+	sysenter
+%%fast:
+	mov	ecx,[esp]
+	mov	edx,[esp+4]
+%%ret:
+	add	esp,12
+	pop	ebp
+%else
+	int	IPC_SYSCALL_VECTOR
+%endif
+%endmacro
 	
 	
 	;;/**
@@ -71,7 +143,7 @@ ipc_send:
 	mov	edx,dword [esi+8]
 	mov	edi,[ebp+8]
         mov     esi,IPC_SEND_NUM
-        int     IPC_SYSCALL_VECTOR
+        ipc_trap
         pop     edx
         pop     ecx
         pop     ebx
@@ -107,7 +179,7 @@ ipc_receive:
 	push	edx
         mov     edi,[ebp+8]
         mov     esi,IPC_RECEIVE_NUM
-        int     IPC_SYSCALL_VECTOR
+        ipc_trap
 	mov     edi,[ebp+12]
 	mov	dword [edi],ebx
 	mov	dword [edi+4],ecx
@@ -128,7 +200,9 @@ ipc_receive:
 	;; 	Function: u8_t ipc_notify(int to)
 	;;	---------------------------------
 	;;
-	;; 	Notify thread `to` of blocking send end
+	;; 	Notify `to` of blocking send end, or post it an asynchronous
+	;; 	notification if none of its threads is blocked sending to us.
+	;; 	Never blocks.
 	;;
 	;;**/
 
@@ -142,7 +216,7 @@ ipc_notify:
         push    edx
         mov     edi,[ebp+8]
         mov     esi,IPC_NOTIFY_NUM
-        int     IPC_SYSCALL_VECTOR
+        ipc_trap
         pop     edx
         pop     ebx
         pop     edi
@@ -159,8 +233,8 @@ ipc_notify:
 	;;
 	;; 	Send a messge to thread `to` and wait for a response message
 	;;
-	;; 	Simply call `ipc_send` the `ipc_receive` if first call succeed
-	;; 	then a notify is sent to thread sending response.
+	;; 	Single syscall: `msg` is passed like in `ipc_send` and the response
+	;; 	is retrieved like in `ipc_receive`. No notify is needed.
 	;;
 	;;**/
 
@@ -170,25 +244,557 @@ ipc_sendrec:
         mov     ebp,esp
         push    esi
         push    edi
-        push 	dword [ebp+12]
-        push 	dword [ebp+8]   
-	call	ipc_send
-	add	esp,8
-	cmp 	eax,IPC_SUCCESS
-	jne	ipc_sendrec_end
-	push 	dword [ebp+12]
-        push 	dword [ebp+8]    
-	call	ipc_receive
-	add	esp,8
-	cmp 	eax,IPC_SUCCESS
-	jne	ipc_sendrec_end
-        push 	dword [ebp+8]
-	call	ipc_notify
-	add	esp,4
-ipc_sendrec_end:	
+        push    ebx
+        push    ecx
+	push	edx
+        mov     esi,[ebp+12]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	mov	edx,dword [esi+8]
+	mov	edi,[ebp+8]
+        mov     esi,IPC_SENDREC_NUM
+        ipc_trap
+	mov     edi,[ebp+12]
+	mov	dword [edi],ebx
+	mov	dword [edi+4],ecx
+	mov	dword [edi+8],edx
+	mov	dword [edi+12],esi
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	ipc_reply_receive(int to, ipc_message* msg) 
+	;;	-------------------------------------------
+	;;
+	;; 	Reply `msg` to thread `to`, which is waiting in `ipc_sendrec`,
+	;; 	then wait for a message from ANY thread into `msg`.
+	;;
+	;; 	`to` can be ANY to simply wait for the first message.
+	;; 	A reply `to` cannot take (not waiting anymore) is dropped: the receive 
+	;; 	still occurs and its status is returned.
+	;;
+	;;**/
+
+	
+ipc_reply_receive:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    ecx
+	push	edx
+        mov     esi,[ebp+12]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	mov	edx,dword [esi+8]
+	mov	edi,[ebp+8]
+        mov     esi,IPC_REPLY_RECEIVE_NUM
+        ipc_trap
+	mov     edi,[ebp+12]
+	mov	dword [edi],ebx
+	mov	dword [edi+4],ecx
+	mov	dword [edi+8],edx
+	mov	dword [edi+12],esi
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_mailbox(void)
+	;;	--------------------------------
+	;;
+	;; 	Give an asynchronous mailbox to the current process:
+	;; 	sends to it no longer block while the mailbox has room
+	;;
+	;;**/
+
+	
+ipc_mailbox:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     esi,IPC_MAILBOX_NUM
+        ipc_trap
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: struct ipc_utcb* ipc_utcb(void)
+	;;	-----------------------------------------
+	;;
+	;; 	Return the current thread UTCB (created on first call),
+	;; 	NULL on failure
+	;;
+	;;**/
+
+	
+ipc_utcb:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     esi,IPC_UTCB_NUM
+        ipc_trap
+        cmp     eax,IPC_SUCCESS
+        jne     .fail
+        mov     eax,ebx		; UTCB address
+        jmp     .end
+.fail:
+        xor     eax,eax
+.end:
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_map(int to, ipc_message* msg)
+	;;	------------------------------------------------
+	;;
+	;; 	Map pages into `to` address space then send it `msg`, like `ipc_send`.
+	;; 	`msg` data holds source address and pages count (ORed with IPC_MAP_GRANT
+	;; 	to unmap them from sender). Pages land at `to` receive window (see `ipc_window`),
+	;; 	whose address is the third data word of the message `to` receives.
+	;;
+	;;**/
+
+	
+ipc_map:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    ecx
+	push	edx
+        mov     esi,[ebp+12]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	mov	edx,dword [esi+8]
+	mov	edi,[ebp+8]
+        mov     esi,IPC_MAP_NUM
+        ipc_trap
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_send_timeout(int to, ipc_message* msg, u32_t timeout)
+	;;	------------------------------------------------------------------------
+	;;
+	;; 	Like `ipc_send`, but give up after `timeout` clock ticks (returns IPC_TIMEOUT).
+	;; 	`timeout` is passed in syscall number upper bits.
+	;; 	Only delivery is timed: once delivered, a notify is expected as for `ipc_send`.
+	;;
+	;;**/
+
+	
+ipc_send_timeout:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    ecx
+	push	edx
+        mov     esi,[ebp+12]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	mov	edx,dword [esi+8]
+	mov	edi,[ebp+8]
+        mov     esi,[ebp+16]
+	shl	esi,IPC_TIMEOUT_SHIFT
+	or	esi,IPC_SEND_TIMEOUT_NUM
+        ipc_trap
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_receive_timeout(int from, ipc_message* msg, u32_t timeout)
+	;;	-----------------------------------------------------------------------------
+	;;
+	;; 	Like `ipc_receive`, but give up after `timeout` clock ticks (returns IPC_TIMEOUT).
+	;;
+	;;**/
+
+	
+ipc_receive_timeout:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    ecx
+	push	edx
+        mov     edi,[ebp+8]
+        mov     esi,[ebp+16]
+	shl	esi,IPC_TIMEOUT_SHIFT
+	or	esi,IPC_RECEIVE_TIMEOUT_NUM
+        ipc_trap
+	mov     edi,[ebp+12]
+	mov	dword [edi],ebx
+	mov	dword [edi+4],ecx
+	mov	dword [edi+8],edx
+	mov	dword [edi+12],esi
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_receive_set(u32_t* set, ipc_message* msg)
+	;;	------------------------------------------------------------
+	;;
+	;; 	Receive a message from any source in `set` (IPC_SET_WORDS words, see IPC_SET_ADD).
+	;; 	Bit `pid` stands for process `pid` only (pids are below IPC_SET_PIDS).
+	;; 	Waiting senders are taken in set bit order (lowest first), and
+	;; 	notifications from the set are accepted too.
+	;; 	The set is passed in EBX and ECX.
+	;;
+	;;**/
+
+	
+ipc_receive_set:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    ecx
+	push	edx
+        mov     esi,[ebp+8]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	xor	edi,edi
+        mov     esi,IPC_RECEIVE_SET_NUM
+        ipc_trap
+	mov     edi,[ebp+12]
+	mov	dword [edi],ebx
+	mov	dword [edi+4],ecx
+	mov	dword [edi+8],edx
+	mov	dword [edi+12],esi
+        pop     edx
+        pop     ecx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: int ipc_handle(int pid)
+	;;	---------------------------------
+	;;
+	;; 	Return an endpoint handle on process `pid`, to be used as
+	;; 	destination instead of `pid` (IPC_HANDLE flag is set), 0 on failure
+	;;
+	;;**/
+
+	
+ipc_handle:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        mov     edi,[ebp+8]
+        mov     esi,IPC_HANDLE_NUM
+        ipc_trap
+        cmp     eax,IPC_SUCCESS
+        jne     .fail
+        mov     eax,ebx		; Handle
+        jmp     .end
+.fail:
+        xor     eax,eax
+.end:
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_handle_close(int handle)
+	;;	-------------------------------------------
+	;;
+	;; 	Release an endpoint handle, even a stale one
+	;;
+	;;**/
+
+	
+ipc_handle_close:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     ebx,[ebp+8]
+        mov     esi,IPC_HANDLE_CLOSE_NUM
+        ipc_trap
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: int ipc_send_batch(struct ipc_batch* batch, u32_t n)
+	;;	--------------------------------------------------------------
+	;;
+	;; 	Send the `n` messages of `batch` in a single trap, without blocking.
+	;; 	Entries are registers only messages, to a process or a handle (no group).
+	;; 	Return the number of messages delivered (in order), -1 on failure
+	;;
+	;;**/
+
+	
+ipc_send_batch:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     ebx,[ebp+8]
+        mov     ecx,[ebp+12]
+        mov     esi,IPC_SEND_BATCH_NUM
+        ipc_trap
+        cmp     eax,IPC_SUCCESS
+        jne     .fail
+        mov     eax,ebx		; Delivered count
+        jmp     .end
+.fail:
+        mov     eax,-1
+.end:
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_channel(int to, struct ipc_channel* ch, u32_t npages)
+	;;	------------------------------------------------------------------------
+	;;
+	;; 	Set up a channel produced by the current process and consumed by `to`:
+	;; 	`npages` free pages at `ch` are backed by kernel and shared with `to`
+	;; 	at its receive window, then `to` is sent a message describing them
+	;; 	(as with `ipc_map`)
+	;;
+	;;**/
+
+	
+ipc_channel:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        mov     edi,[ebp+8]
+        mov     ebx,[ebp+12]
+        mov     ecx,[ebp+16]
+        mov     esi,IPC_CHANNEL_NUM
+        ipc_trap
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_group(int group, u8_t join)
+	;;	----------------------------------------------
+	;;
+	;; 	Make the current process join `group` (`join` is TRUE) or leave it
+	;;
+	;;**/
+
+	
+ipc_group:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     ebx,[ebp+8]
+        mov     ecx,[ebp+12]
+        mov     esi,IPC_GROUP_NUM
+        ipc_trap
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: int ipc_group_send(int group, struct ipc_message* msg, u8_t partial, u32_t* missed)
+	;;	---------------------------------------------------------------------------------------------
+	;;
+	;; 	Send `msg` to every member of `group` (but the current process) in a single trap.
+	;; 	Members must be receiving or have room in their mailbox, otherwise nothing is sent,
+	;; 	unless `partial` is TRUE: members not ready are then skipped.
+	;; 	Never blocks, even without `partial`: caller retries the members it missed.
+	;; 	If `missed` is not NULL, it gets the sources set (IPC_SET_WORDS words) of members
+	;; 	not reached, on failure too. Return the number of members reached, -1 on failure
+	;;
+	;;**/
+
+	
+ipc_group_send:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+	push	edx
+        mov     esi,[ebp+12]
+	mov	ebx,dword [esi]
+	mov	ecx,dword [esi+4]
+	mov	edx,dword [esi+8]
+	mov	edi,[ebp+8]
+	or	edi,IPC_GROUP
+	cmp	byte [ebp+16],0
+	je	.send
+	or	edi,IPC_GROUP_PARTIAL
+.send:
+        mov     esi,IPC_GROUP_SEND_NUM
+        ipc_trap
+	mov	esi,[ebp+20]
+	test	esi,esi
+	jz	.result
+	mov	dword [esi],ecx	; Members missed
+	mov	dword [esi+4],edx
+.result:
+        cmp     eax,IPC_SUCCESS
+        jne     .fail
+        mov     eax,ebx		; Members reached
+        jmp     .end
+.fail:
+        mov     eax,-1
+.end:
+        pop     edx
+        pop     ebx
+        pop     edi
+        pop     esi
+        mov     esp,ebp
+        pop     ebp
+        ret
+
+
+	;;/**
+	;;
+	;; 	Function: u8_t ipc_window(void* base, u32_t npages)
+	;;	---------------------------------------------------
+	;;
+	;; 	Open the current process receive window: the next `ipc_map` (or `ipc_channel`)
+	;; 	to it maps up to `npages` pages at `base`, which must be free. 
+	;; 	That map closes the window, as does an `npages` of 0.
+	;;
+	;;**/
+
+	
+ipc_window:
+        push    ebp
+        mov     ebp,esp
+        push    esi
+        push    edi
+        push    ebx
+        push    edx
+        xor     edi,edi
+        mov     ebx,[ebp+8]
+        mov     ecx,[ebp+12]
+        mov     esi,IPC_WINDOW_NUM
+        ipc_trap
+        pop     edx
+        pop     ebx
         pop     edi
         pop     esi
         mov     esp,ebp
         pop     ebp
         ret
-	
\ No newline at end of file
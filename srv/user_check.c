@@ -0,0 +1,852 @@
+/**
+
+   user_check.c
+   ============
+
+   Self-check program for IPC primitives, run besides the user_send/user_recv demo.
+
+   Each check exercises a primitive and its error paths, using demo processes
+   as peers: user_recv (CHECK_RECV_PID) replies to any sendrec, user_send
+   processes (CHECK_SEND_PID, CHECK_BUSY_PID) only talk to user_recv, so they
+   never receive from us and have no mailbox. Checks needing a cooperative process
+   use user_peer (CHECK_PEER_PID), see user_check.h for its operations.
+
+   Checks run once, then the program waits forever. Failed checks are recorded in
+   `check_failed` (bit CHECK_xxx), and every IPC result is traced by kernel on
+   serial line ("end of syscall").
+
+**/
+
+
+#include <define.h>
+#include <types.h>
+#include <ipc.h>
+#include "user_check.h"
+
+
+/**
+
+   Constant: CHECK_TICKS
+   ---------------------
+
+   Timeout of timed checks, in clock ticks
+
+**/
+
+#define CHECK_TICKS      5
+
+
+/**
+
+   Constant: CHECK_ROUNDS
+   ----------------------
+
+   Number of round trips in round trip checks
+
+**/
+
+#define CHECK_ROUNDS     16
+
+
+/**
+
+   Constant: CHECK_RING
+   --------------------
+
+   Free address where channel ring is set up
+
+**/
+
+#define CHECK_RING       0xC0000000
+
+
+/**
+
+   Constants: Checks
+   -----------------
+
+   Bit of each check in `check_failed`
+
+**/
+
+#define CHECK_TIMEOUT    (1<<0)
+#define CHECK_NOTIFY     (1<<1)
+#define CHECK_SET        (1<<2)
+#define CHECK_BATCH      (1<<3)
+#define CHECK_MAILBOX    (1<<4)
+#define CHECK_SENDREC    (1<<5)
+#define CHECK_HANDLE     (1<<6)
+#define CHECK_UTCB       (1<<7)
+#define CHECK_DEADLOCK   (1<<8)
+#define CHECK_MAP        (1<<9)
+#define CHECK_GROUP_SEND (1<<10)
+#define CHECK_CHANNEL    (1<<11)
+
+
+/**
+
+   Global: check_failed
+   --------------------
+
+   Failed checks
+
+**/
+
+u32_t check_failed;
+
+
+/**
+
+   Global: check_page
+   ------------------
+
+   A page to map
+
+**/
+
+u32_t check_page[1024] __attribute__((aligned(4096)));
+
+
+u8_t check_timeout(void);
+u8_t check_notify(void);
+u8_t check_set(void);
+u8_t check_batch(void);
+u8_t check_mailbox(void);
+u8_t check_sendrec(void);
+u8_t check_handle(void);
+u8_t check_utcb(void);
+u8_t check_deadlock(void);
+u8_t check_map(void);
+u8_t check_group(void);
+u8_t check_channel(void);
+
+
+
+
+int main()
+{
+  struct ipc_message m;
+
+  check_failed = 0;
+
+  if (check_timeout() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_TIMEOUT;
+    }
+
+  if (check_notify() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_NOTIFY;
+    }
+
+  if (check_set() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_SET;
+    }
+
+  if (check_batch() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_BATCH;
+    }
+
+  if (check_mailbox() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_MAILBOX;
+    }
+
+  if (check_sendrec() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_SENDREC;
+    }
+
+  if (check_handle() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_HANDLE;
+    }
+
+  if (check_utcb() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_UTCB;
+    }
+
+  if (check_deadlock() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_DEADLOCK;
+    }
+
+  if (check_map() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_MAP;
+    }
+
+  if (check_group() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_GROUP_SEND;
+    }
+
+  if (check_channel() != IPC_SUCCESS)
+    {
+      check_failed |= CHECK_CHANNEL;
+    }
+
+  /* Done: wait forever (user_send processes never send to us) */
+  while(1)
+    {
+      ipc_receive(CHECK_BUSY_PID,&m);
+    }
+
+  return 0;
+}
+
+
+
+/**
+
+   Function: u8_t check_timeout(void)
+   ----------------------------------
+
+   Poll send to a process with no mailbox nor receiver gives up right away,
+   timed send and timed receive nobody answers expire.
+
+**/
+
+u8_t check_timeout(void)
+{
+  struct ipc_message m;
+
+  /* No mailbox, not receiving from us: poll must not block */
+  if (ipc_send_timeout(CHECK_SEND_PID,&m,IPC_TIMEOUT_POLL) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Queued in a wait list, then expired */
+  if (ipc_send_timeout(CHECK_BUSY_PID,&m,CHECK_TICKS) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Nobody sends to us */
+  if (ipc_receive_timeout(CHECK_SEND_PID,&m,CHECK_TICKS) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_receive_timeout(CHECK_SEND_PID,&m,IPC_TIMEOUT_POLL) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_notify(void)
+   ---------------------------------
+
+   Notifications to ourselves stay pending (several collapse into one), then come 
+   as a single message whose bitmap holds our bit only, pid `n` being bit `n` exactly.
+
+**/
+
+u8_t check_notify(void)
+{
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+
+  if ( (ipc_notify(CHECK_PID) != IPC_SUCCESS) || (ipc_notify(CHECK_PID) != IPC_SUCCESS) )
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_receive_timeout(IPC_ANY,&m,IPC_TIMEOUT_POLL) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (m.from != IPC_NOTIFICATION) || (data[0] != (1<<CHECK_PID)) || (data[1]) )
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Delivered once */
+  if (ipc_receive_timeout(IPC_ANY,&m,IPC_TIMEOUT_POLL) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_set(void)
+   ------------------------------
+
+   A pid aliasing ours in a set (`pid` + IPC_SET_PIDS) is neither added nor member,
+   and is no process. A receive from a set holding our pid gets our notification.
+
+**/
+
+u8_t check_set(void)
+{
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  u32_t set[IPC_SET_WORDS];
+
+  set[0] = 0;
+  set[1] = 0;
+
+  /* Aliased pid */
+  IPC_SET_ADD(set,CHECK_PID+IPC_SET_PIDS);
+  if ( (set[0]) || (set[1]) )
+    {
+      return IPC_FAILURE;
+    }
+
+  IPC_SET_ADD(set,CHECK_PID);
+  if ( (!IPC_SET_ISIN(set,CHECK_PID)) || (IPC_SET_ISIN(set,CHECK_PID+IPC_SET_PIDS)) )
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_send_timeout(CHECK_PID+IPC_SET_PIDS,&m,IPC_TIMEOUT_POLL) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Receive from set */
+  if (ipc_notify(CHECK_PID) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_receive_set(set,&m) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (m.from != IPC_NOTIFICATION) || (data[0] != (1<<CHECK_PID)) || (data[1]) )
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_batch(void)
+   --------------------------------
+
+   A batch never blocks: it stops at an entry to a process with no mailbox nor
+   receiver, or to a group. Once our mailbox is on, entries to ourselves are
+   posted there, and our acknowledgement of them is dropped.
+
+**/
+
+u8_t check_batch(void)
+{
+  struct ipc_batch batch[3];
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  u32_t i;
+
+  for(i=0;i<3;i++)
+    {
+      batch[i].to = CHECK_PID;
+      ((u32_t*)batch[i].msg.data)[0] = 0xC0DE0000 + i;
+      ((u32_t*)batch[i].msg.data)[1] = i;
+      ((u32_t*)batch[i].msg.data)[2] = ~i;
+    }
+
+  /* No mailbox yet */
+  if (ipc_send_batch(batch,1) != 0)
+    {
+      return IPC_FAILURE;
+    }
+
+  batch[0].to = CHECK_SEND_PID;
+  if (ipc_send_batch(batch,1) != 0)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_mailbox() != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Group destination stops delivery */
+  batch[0].to = CHECK_PID;
+  batch[1].to = IPC_GROUP|1;
+  if (ipc_send_batch(batch,3) != 1)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (ipc_receive_timeout(CHECK_PID,&m,IPC_TIMEOUT_POLL) != IPC_SUCCESS)
+       || (m.from != CHECK_PID) || (data[0] != 0xC0DE0000) || (data[1] != 0) || (data[2] != ~0) )
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Acknowledge, dropped by kernel */
+  if (ipc_notify(CHECK_PID) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_receive_timeout(IPC_ANY,&m,IPC_TIMEOUT_POLL) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_mailbox(void)
+   ----------------------------------
+
+   Two messages from the same source wait in our mailbox, in order.
+   Acknowledging both drops both notifications: none is left pending.
+
+**/
+
+u8_t check_mailbox(void)
+{
+  struct ipc_batch batch[2];
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  u32_t i;
+
+  if (ipc_mailbox() != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<2;i++)
+    {
+      batch[i].to = CHECK_PID;
+      ((u32_t*)batch[i].msg.data)[0] = i;
+    }
+
+  if (ipc_send_batch(batch,2) != 2)
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<2;i++)
+    {
+      if ( (ipc_receive_timeout(CHECK_PID,&m,IPC_TIMEOUT_POLL) != IPC_SUCCESS)
+	   || (m.from != CHECK_PID) || (data[0] != i) )
+	{
+	  return IPC_FAILURE;
+	}
+    }
+
+  for(i=0;i<2;i++)
+    {
+      if (ipc_notify(CHECK_PID) != IPC_SUCCESS)
+	{
+	  return IPC_FAILURE;
+	}
+    }
+
+  if (ipc_receive_timeout(IPC_ANY,&m,IPC_TIMEOUT_POLL) != IPC_TIMEOUT)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_sendrec(void)
+   ----------------------------------
+
+   Round trips with user_recv, which replies with the message it got
+   (fast path when it is already waiting): each one succeeds and brings
+   our message back from it.
+
+**/
+
+u8_t check_sendrec(void)
+{
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  u32_t i;
+
+  for(i=0;i<CHECK_ROUNDS;i++)
+    {
+      data[0] = i;
+      data[1] = ~i;
+      data[2] = CHECK_PID;
+
+      if (ipc_sendrec(CHECK_RECV_PID,&m) != IPC_SUCCESS)
+	{
+	  return IPC_FAILURE;
+	}
+
+      if ( (m.from != CHECK_RECV_PID) || (data[0] != i) || (data[1] != ~i) || (data[2] != CHECK_PID) )
+	{
+	  return IPC_FAILURE;
+	}
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_handle(void)
+   ---------------------------------
+
+   A handle on user_recv reaches it like its pid (and is given once per endpoint),
+   no handle is given on a missing process, and a closed handle is refused.
+
+**/
+
+u8_t check_handle(void)
+{
+  struct ipc_message m;
+  int h;
+
+  h = ipc_handle(CHECK_RECV_PID);
+  if ( (!h) || (!(h & IPC_HANDLE)) || (ipc_handle(CHECK_RECV_PID) != h) )
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (ipc_sendrec(h,&m) != IPC_SUCCESS) || (m.from != CHECK_RECV_PID) )
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_handle(CHECK_PID+IPC_SET_PIDS))
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_handle_close(h) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (ipc_handle_close(h) != IPC_FAILURE) || (ipc_sendrec(h,&m) != IPC_FAILURE) )
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_utcb(void)
+   -------------------------------
+
+   Our UTCB is given once, above user space code. A long message is sent along
+   with a sendrec: its length is reset once sent, and the registers only reply
+   sets our received length to 0.
+
+**/
+
+u8_t check_utcb(void)
+{
+  struct ipc_utcb* utcb;
+  struct ipc_message m;
+  u32_t i;
+
+  utcb = ipc_utcb();
+  if ( (utcb == NULL) || (ipc_utcb() != utcb) || ((u32_t)utcb < 0x80000000) )
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<IPC_UTCB_MR;i++)
+    {
+      utcb->mr[i] = i;
+    }
+  utcb->send_len = IPC_UTCB_MR;
+  utcb->recv_len = IPC_UTCB_MR;
+
+  if (ipc_sendrec(CHECK_RECV_PID,&m) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (utcb->send_len) || (utcb->recv_len) )
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_deadlock(void)
+   -----------------------------------
+
+   Sending to ourselves, with no other thread to receive, is a deadlock:
+   refused right away rather than timed out (or blocked forever), 
+   mailbox or not.
+
+**/
+
+u8_t check_deadlock(void)
+{
+  struct ipc_message m;
+
+  if (ipc_send_timeout(CHECK_PID,&m,CHECK_TICKS) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_sendrec(CHECK_PID,&m) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_map(void)
+   ------------------------------
+
+   Pages only go to an open receive window: mapping or granting a backed page
+   to a process with no window fails (and the page stays ours). A window must
+   be page aligned in user space.
+
+**/
+
+u8_t check_map(void)
+{
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+
+  /* Back it */
+  check_page[0] = CHECK_PID;
+
+  data[0] = (u32_t)check_page;
+  data[1] = 1;
+  data[2] = 0;
+  if (ipc_map(CHECK_SEND_PID,&m) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  data[1] = 1|IPC_MAP_GRANT;
+  if (ipc_map(CHECK_SEND_PID,&m) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (check_page[0] != CHECK_PID)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (ipc_window((void*)((u32_t)check_page+1),1) != IPC_FAILURE)
+       || (ipc_window((void*)0x1000,1) != IPC_FAILURE) )
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
+
+
+
+/**
+
+   Function: u8_t check_group(void)
+   --------------------------------
+
+   Group sends reach every member but ourselves, registers only.
+   While our peer does not receive from us, a strict group send fails and a partial 
+   one reaches nobody, both reporting the peer as missed. Once it is back, a strict
+   group send reaches it again.
+
+**/
+
+u8_t check_group(void)
+{
+  struct ipc_message m;
+  struct ipc_utcb* utcb;
+  u32_t* data = (u32_t*)m.data;
+  u32_t missed[IPC_SET_WORDS];
+  u8_t res;
+  int n;
+
+  if (ipc_group(CHECK_GROUP,TRUE) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  res = IPC_FAILURE;
+
+  /* Peer receives again once it replied */
+  data[0] = CHECK_OP_ECHO;
+  if (ipc_sendrec(CHECK_PEER_PID,&m) != IPC_SUCCESS)
+    {
+      goto end;
+    }
+
+  data[0] = CHECK_OP_GROUP;
+  if ( (ipc_group_send(CHECK_GROUP,&m,FALSE,missed) != 1) || (missed[0]) || (missed[1]) )
+    {
+      goto end;
+    }
+
+  /* Long message refused */
+  utcb = ipc_utcb();
+  utcb->send_len = 1;
+  n = ipc_group_send(CHECK_GROUP,&m,TRUE,NULL);
+  utcb->send_len = 0;
+  if (n != -1)
+    {
+      goto end;
+    }
+
+  /* Peer deaf for a while */
+  data[0] = CHECK_OP_DEAF;
+  if (ipc_sendrec(CHECK_PEER_PID,&m) != IPC_SUCCESS)
+    {
+      goto end;
+    }
+
+  data[0] = CHECK_OP_GROUP;
+  if ( (ipc_group_send(CHECK_GROUP,&m,FALSE,missed) != -1) || (!IPC_SET_ISIN(missed,CHECK_PEER_PID)) )
+    {
+      goto end;
+    }
+
+  missed[0] = 0;
+  missed[1] = 0;
+  if ( (ipc_group_send(CHECK_GROUP,&m,TRUE,missed) != 0) || (!IPC_SET_ISIN(missed,CHECK_PEER_PID)) )
+    {
+      goto end;
+    }
+
+  /* Wait for it to be back */
+  data[0] = CHECK_OP_ECHO;
+  if (ipc_sendrec(CHECK_PEER_PID,&m) != IPC_SUCCESS)
+    {
+      goto end;
+    }
+
+  data[0] = CHECK_OP_GROUP;
+  if (ipc_group_send(CHECK_GROUP,&m,FALSE,missed) != 1)
+    {
+      goto end;
+    }
+
+  res = IPC_SUCCESS;
+
+ end:
+  ipc_group(CHECK_GROUP,FALSE);
+  return res;
+}
+
+
+
+/**
+
+   Function: u8_t check_channel(void)
+   ----------------------------------
+
+   A channel to a process with no receive window fails, its ring pages being
+   released: the same ones can then make a channel to our peer. Records put in
+   the ring are consumed by the peer, which sends back how many it got right.
+
+**/
+
+u8_t check_channel(void)
+{
+  struct ipc_channel* ch;
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  u32_t rec[IPC_CHANNEL_REC];
+  u32_t i;
+
+  ch = (struct ipc_channel*)CHECK_RING;
+
+  if (ipc_channel(CHECK_SEND_PID,ch,1) != IPC_FAILURE)
+    {
+      return IPC_FAILURE;
+    }
+
+  /* Peer window is open once it replied */
+  data[0] = CHECK_OP_ECHO;
+  if (ipc_sendrec(CHECK_PEER_PID,&m) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if (ipc_channel(CHECK_PEER_PID,ch,1) != IPC_SUCCESS)
+    {
+      return IPC_FAILURE;
+    }
+
+  if ( (!ch->size) || (ch->producer != CHECK_PID) || (ch->consumer != CHECK_PEER_PID) )
+    {
+      return IPC_FAILURE;
+    }
+
+  for(i=0;i<CHECK_RECS;i++)
+    {
+      rec[0] = i;
+      rec[1] = ~i;
+      rec[2] = CHECK_PID;
+
+      if (ipc_channel_put(ch,rec) != IPC_SUCCESS)
+	{
+	  return IPC_FAILURE;
+	}
+    }
+
+  /* Peer count, acknowledged */
+  do
+    {
+      if (ipc_receive(CHECK_PEER_PID,&m) != IPC_SUCCESS)
+	{
+	  return IPC_FAILURE;
+	}
+    }
+  while(m.from == IPC_NOTIFICATION);
+
+  ipc_notify(CHECK_PEER_PID);
+
+  if (data[0] != CHECK_RECS)
+    {
+      return IPC_FAILURE;
+    }
+
+  return IPC_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/**
+
+   user_check.h
+   ============
+
+   Constants shared by IPC self-check program and its peer (user_peer.c)
+
+**/
+
+
+#ifndef USER_CHECK_H
+#define USER_CHECK_H
+
+
+/**
+
+   Constants: Demo processes
+   -------------------------
+
+   Pids given by kernel main, in creation order
+
+**/
+
+#define CHECK_RECV_PID   1
+#define CHECK_SEND_PID   2
+#define CHECK_BUSY_PID   3
+#define CHECK_PID        4
+#define CHECK_PEER_PID   5
+
+
+/**
+
+   Constants: Peer operations
+   --------------------------
+
+   Operation asked to peer, in first message word
+
+   - CHECK_OP_ECHO  : reply message as is
+   - CHECK_OP_DEAF  : reply, then stop receiving from self-check for CHECK_DEAF_TICKS
+   - CHECK_OP_GROUP : group message, acknowledged by a notification
+
+**/
+
+#define CHECK_OP_ECHO    1
+#define CHECK_OP_DEAF    2
+#define CHECK_OP_GROUP   3
+
+
+/**
+
+   Constant: CHECK_DEAF_TICKS
+   --------------------------
+
+   Time peer spends not receiving from self-check, in clock ticks
+
+**/
+
+#define CHECK_DEAF_TICKS 50
+
+
+/**
+
+   Constant: CHECK_GROUP
+   ---------------------
+
+   Group joined by self-check and its peer
+
+**/
+
+#define CHECK_GROUP      7
+
+
+/**
+
+   Constants: Peer window
+   ----------------------
+
+   Peer receive window (address and pages), where channel rings land
+
+**/
+
+#define CHECK_WINDOW       0xC0000000
+#define CHECK_WINDOW_PAGES 1
+
+
+/**
+
+   Constant: CHECK_RECS
+   --------------------
+
+   Records produced in channel check, echoed back by peer as a count
+
+**/
+
+#define CHECK_RECS       3
+
+
+#endif
@@ -0,0 +1,123 @@
+/**
+
+   user_peer.c
+   ===========
+
+   Peer of IPC self-check program (user_check.c), for checks needing a cooperative
+   process: it joins CHECK_GROUP, opens its receive window at CHECK_WINDOW,
+   then serves self-check requests (operation in first message word).
+   Channel messages (landing at CHECK_WINDOW) are consumed and the number of 
+   expected records is sent back.
+
+**/
+
+
+#include <define.h>
+#include <types.h>
+#include <ipc.h>
+#include "user_check.h"
+
+
+u32_t peer_channel(int from, struct ipc_channel* ch);
+
+
+
+
+int main()
+{
+  struct ipc_message m;
+  u32_t* data = (u32_t*)m.data;
+  int to;
+
+  ipc_group(CHECK_GROUP,TRUE);
+  ipc_window((void*)CHECK_WINDOW,CHECK_WINDOW_PAGES);
+
+  /* Nothing to reply at first */
+  to = IPC_ANY;
+
+  while(1)
+    {
+      if (ipc_reply_receive(to,&m) != IPC_SUCCESS)
+	{
+	  to = IPC_ANY;
+	  continue;
+	}
+
+      to = IPC_ANY;
+
+      /* Notifications expect no reply */
+      if (m.from == IPC_NOTIFICATION)
+	{
+	  continue;
+	}
+
+      switch(data[0])
+	{
+	case CHECK_OP_ECHO:
+	  {
+	    to = m.from;
+	    break;
+	  }
+	case CHECK_OP_DEAF:
+	  {
+	    /* Reply now, then receive from someone who never sends */
+	    ipc_send(m.from,&m);
+	    ipc_receive_timeout(CHECK_RECV_PID,&m,CHECK_DEAF_TICKS);
+	    break;
+	  }
+	case CHECK_OP_GROUP:
+	  {
+	    ipc_notify(m.from);
+	    break;
+	  }
+	default:
+	  {
+	    if (data[2] == CHECK_WINDOW)
+	      {
+		ipc_notify(m.from);
+		data[0] = peer_channel(m.from,(struct ipc_channel*)CHECK_WINDOW);
+		ipc_send(m.from,&m);
+	      }
+	    break;
+	  }
+	}
+    }
+
+  return 0;
+}
+
+
+
+/**
+
+   Function: u32_t peer_channel(int from, struct ipc_channel* ch)
+   --------------------------------------------------------------
+
+   Consume CHECK_RECS records from channel `ch` produced by `from`,
+   waiting for its notification when ring is empty.
+   Return the number of records holding what self-check puts (i, ~i).
+
+**/
+
+u32_t peer_channel(int from, struct ipc_channel* ch)
+{
+  struct ipc_message m;
+  u32_t rec[IPC_CHANNEL_REC];
+  u32_t i,n;
+
+  n = 0;
+  for(i=0;i<CHECK_RECS;i++)
+    {
+      while(ipc_channel_get(ch,rec) != IPC_SUCCESS)
+	{
+	  ipc_receive(from,&m);
+	}
+
+      if ( (rec[0] == i) && (rec[1] == ~i) )
+	{
+	  n++;
+	}
+    }
+
+  return n;
+}
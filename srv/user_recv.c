@@ -29,9 +29,20 @@ int main()
 {
   struct ipc_message m;
   struct calc_msg cm;
+  int to;
 
-  while(ipc_receive(IPC_ANY,&m)==IPC_SUCCESS)
+  /* Nothing to reply at first */
+  to = IPC_ANY;
+
+  while(ipc_reply_receive(to,&m)==IPC_SUCCESS)
     {
+      /* Notifications expect no reply */
+      if (m.from == IPC_NOTIFICATION)
+	{
+	  to = IPC_ANY;
+	  continue;
+	}
+
       //mem_copy((addr_t)m.data,(addr_t)&cm,sizeof(struct calc_msg)); 
       
       switch(cm.op_code)
@@ -46,8 +57,7 @@ int main()
           cm.op_res = 0;
         }
       //mem_copy((addr_t)&cm,(addr_t)m.data,sizeof(struct calc_msg));
-      ipc_notify(m.from);
-      ipc_send(m.from,&m);
+      to = m.from;
     }
   
   //while(1){}
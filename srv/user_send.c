@@ -5,6 +5,10 @@
 
    Test program that do a sendrec to a computing thread
 
+   It also drives round trips measure (ping-pong with user_recv): kernel
+   averages CPU cycles from sendrec to reply delivery and prints it on
+   serial line with its IPC statistics ("sendrec round trip").
+
 **/
 
 
@@ -27,10 +31,17 @@ struct calc_msg
 
 int main()
 {
-  int j;
+  int j,to;
   struct ipc_message m;
   struct calc_msg cm;
 
+  /* Talk to computing thread through an endpoint handle if possible */
+  to = ipc_handle(1);
+  if (!to)
+    {
+      to = 1;
+    }
+
   cm.op_code = 2;
   j=1;
 
@@ -39,7 +50,7 @@ int main()
       cm.op_1 = j%10;
       cm.op_2 = j%100;
       //mem_copy((addr_t)&cm,(addr_t)m.data,sizeof(struct calc_msg));
-      if (ipc_sendrec(1,&m)!=IPC_SUCCESS)
+      if (ipc_sendrec(to,&m)!=IPC_SUCCESS)
       	{
       	  break;
       	}
@@ -65,3 +76,4 @@ void mem_copy(addr_t src, addr_t dst, u32_t len)
 
   return;      
 }
+
@@ -98,7 +98,7 @@ mkdir $MNT/srv
 /home/g4b/grub/sbin/grub-install --modules=part_msdos --root-directory=$MNT /dev/loop0
 
 # Grub boot menu
-printf "set timeout=10\nset default=0\n\nmenuentry \"RhinOS\" {\n\tmultiboot /kern/kern\n\tmodule /srv/user_recv receiver\n\tmodule /srv/user_send_0 sender0\n\tmodule /srv/user_send1 sender1\n\tboot\n}\n" > $MNT/boot/grub/grub.cfg
+printf "set timeout=10\nset default=0\n\nmenuentry \"RhinOS\" {\n\tmultiboot /kern/kern\n\tmodule /srv/user_recv receiver\n\tmodule /srv/user_send_0 sender0\n\tmodule /srv/user_check check\n\tmodule /srv/user_peer peer\n\tboot\n}\n" > $MNT/boot/grub/grub.cfg
 
 
 # Clean